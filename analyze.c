@@ -0,0 +1,490 @@
+// analyze.c -- streaming summary of memtest() results, replaces plot.ipynb.
+//
+// The notebook loads all of results.csv into pandas; at REPEAT=1000000
+// over 13 sizes that is 13M rows and it does not fit. This tool mmaps the
+// file and makes one pass over it, folding every sample into the same
+// log-bucketed histogram sample_sink.h uses (buckets <= 1/32 of their
+// value wide), plus exact count / sum / min / max and per-sample counter
+// sums. Everything else comes from the histogram, per size:
+//   mean (exact, see below), trimmed mean (-t, default 5% off each end),
+//   p1 .. p99.9 (interpolated within a bucket), up to three modes (peaks of the
+//   count/width density holding >= MODE_MIN of the samples), and Tukey
+//   outliers below Q1 - 1.5 IQR and above Q3 + 1.5 IQR.
+//
+// Input is either the CSV export ("Size(Bytes),Time(Ticks)[,counters]")
+// or results.bin, the SNK1 dump of sink_finish() (v1 or v2). For .bin the
+// histogram is taken straight from each record, so the statistics cover
+// every sample of the run, not only the ones still in the ring; the mean
+// is exact only when the ring kept every sample. Several records of the
+// same size (appended runs) are merged.
+//
+// Outputs: a table on stdout, -o summary CSV, -j JSON, -H ASCII histograms
+// (p0..p99 like the notebook, HIST_BINS linear bins) and -g prefix for
+// gnuplot: prefix.dat, prefix_hist.dat and a prefix.gp that draws the
+// mean / p50 curve, a box plot (p1/p25/p50/p75/p99) and the histograms.
+//
+// usage: ./analyze [-t trim] [-o summary.csv] [-j summary.json] [-H] [-g prefix] [file]
+//        (file defaults to results.bin)
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sample_sink.h"
+
+#define MAX_SIZES  64
+#define NQ         8
+#define MAX_MODES  3
+#define MODE_MIN   0.01         // a mode must hold >= 1% of the samples
+#define MODE_WIN   2            // a peak beats this many buckets either side
+#define HIST_BINS  40
+#define HIST_WIDTH 60
+
+static const double qs[NQ] = { 0.01, 0.05, 0.25, 0.50, 0.75, 0.90, 0.99, 0.999 };
+static const char *qname[NQ] = { "p1", "p5", "p25", "p50", "p75", "p90", "p99", "p99.9" };
+
+struct acc {
+    uint64_t bytes;
+    uint64_t n, sum, min, max;
+    int exact_sum;              // sum covers every sample
+    uint64_t hist[SINK_BUCKETS];
+    uint64_t ctr_sum[SINK_MAX_CTR];
+    uint64_t ctr_n;             // samples the counter sums cover
+};
+
+struct summary {
+    double mean, trim, q[NQ];
+    double mode[MAX_MODES];
+    uint64_t mode_n[MAX_MODES];     // samples in each mode's bucket
+    int nmodes;
+    uint64_t out_lo, out_hi;
+};
+
+static struct acc accs[MAX_SIZES];
+static int naccs;
+static unsigned nctr;
+static char ctr_name[SINK_MAX_CTR][SINK_CTR_NAME + 1];
+
+static struct acc *acc_for(uint64_t bytes) {
+    static int last;
+    if (naccs && accs[last].bytes == bytes) return &accs[last];
+    for (int i = 0; i < naccs; ++i)
+        if (accs[i].bytes == bytes) return &accs[last = i];
+    if (naccs == MAX_SIZES) { fprintf(stderr, "more than %d sizes\n", MAX_SIZES); exit(1); }
+    struct acc *a = &accs[naccs];
+    memset(a, 0, sizeof(*a));
+    a->bytes = bytes;
+    a->min = UINT64_MAX;
+    a->exact_sum = 1;
+    last = naccs++;
+    return a;
+}
+
+static inline uint64_t bucket_hi(unsigned i) {
+    return i + 1 < SINK_BUCKETS ? sink_bucket_lo(i + 1) : UINT64_MAX;
+}
+
+// Value at quantile q, linear inside the bucket, clamped to [min, max].
+static double quantile(const struct acc *a, double q) {
+    double rank = q * (double)(a->n - 1);
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < SINK_BUCKETS; ++i) {
+        if (!a->hist[i]) continue;
+        if ((double)(seen + a->hist[i]) > rank) {
+            double lo = (double)sink_bucket_lo(i), hi = (double)bucket_hi(i);
+            double v = lo + (hi - lo) * (rank - (double)seen) / (double)a->hist[i];
+            if (v < (double)a->min) v = (double)a->min;
+            if (v > (double)a->max) v = (double)a->max;
+            return v;
+        }
+        seen += a->hist[i];
+    }
+    return (double)a->max;
+}
+
+static inline double bucket_mid(const struct acc *a, unsigned i) {
+    double lo = (double)sink_bucket_lo(i), hi = (double)bucket_hi(i) - 1;
+    if (lo < (double)a->min) lo = (double)a->min;
+    if (hi > (double)a->max) hi = (double)a->max;
+    return (lo + hi) / 2;
+}
+
+// Mean of the samples ranked in [trim*n, (1-trim)*n), bucket midpoints.
+static double trimmed_mean(const struct acc *a, double trim) {
+    double from = trim * (double)a->n, to = (1 - trim) * (double)a->n, sum = 0, cnt = 0;
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < SINK_BUCKETS; ++i) {
+        if (!a->hist[i]) continue;
+        double lo = (double)seen, hi = (double)(seen + a->hist[i]);
+        seen += a->hist[i];
+        double take = (hi < to ? hi : to) - (lo > from ? lo : from);
+        if (take <= 0) continue;
+        sum += take * bucket_mid(a, i);
+        cnt += take;
+    }
+    return cnt > 0 ? sum / cnt : 0;
+}
+
+static void summarize(const struct acc *a, double trim, struct summary *s) {
+    memset(s, 0, sizeof(*s));
+    if (!a->n) return;
+    if (a->exact_sum) {
+        s->mean = (double)a->sum / (double)a->n;
+    } else {
+        for (unsigned i = 0; i < SINK_BUCKETS; ++i)
+            if (a->hist[i]) s->mean += (double)a->hist[i] * bucket_mid(a, i);
+        s->mean /= (double)a->n;
+    }
+    s->trim = trimmed_mean(a, trim);
+    for (int k = 0; k < NQ; ++k) s->q[k] = quantile(a, qs[k]);
+
+    double iqr = s->q[4] - s->q[2];
+    double fence_lo = s->q[2] - 1.5 * iqr, fence_hi = s->q[4] + 1.5 * iqr;
+    for (unsigned i = 0; i < SINK_BUCKETS; ++i) {
+        if (!a->hist[i]) continue;
+        if ((double)bucket_hi(i) <= fence_lo) s->out_lo += a->hist[i];
+        else if ((double)sink_bucket_lo(i) > fence_hi) s->out_hi += a->hist[i];
+    }
+
+    // modes: local maxima of count per tick, biggest first
+    for (unsigned i = 0; i < SINK_BUCKETS; ++i) {
+        if ((double)a->hist[i] < MODE_MIN * (double)a->n) continue;
+        double d = (double)a->hist[i] / (double)(bucket_hi(i) - sink_bucket_lo(i));
+        int peak = 1;
+        for (int j = (int)i - MODE_WIN; j <= (int)i + MODE_WIN && peak; ++j) {
+            if (j < 0 || j >= (int)SINK_BUCKETS || j == (int)i) continue;
+            double dj = (double)a->hist[j] / (double)(bucket_hi((unsigned)j) - sink_bucket_lo((unsigned)j));
+            peak = dj < d || (dj == d && j > (int)i);        // plateaus: leftmost bucket wins
+        }
+        if (!peak) continue;
+        int k = s->nmodes;
+        if (k == MAX_MODES) {                                // replace the smallest if bigger
+            if (a->hist[i] <= s->mode_n[k - 1]) continue;
+            --k;
+        } else {
+            ++s->nmodes;
+        }
+        for (; k > 0 && s->mode_n[k - 1] < a->hist[i]; --k) {
+            s->mode[k] = s->mode[k - 1];
+            s->mode_n[k] = s->mode_n[k - 1];
+        }
+        s->mode[k] = bucket_mid(a, i);
+        s->mode_n[k] = a->hist[i];
+    }
+}
+
+// ---------- input ----------
+
+static inline const char *parse_u64(const char *p, const char *end, uint64_t *v) {
+    uint64_t x = 0;
+    while (p < end && (unsigned)(*p - '0') < 10) x = x * 10 + (uint64_t)(*p++ - '0');
+    *v = x;
+    return p;
+}
+
+static int load_csv(const char *p, const char *end) {
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    if (!nl || strncmp(p, "Size(Bytes)", 11)) {
+        fprintf(stderr, "not a results CSV (expected a Size(Bytes),... header)\n");
+        return -1;
+    }
+    int col = 0;                                          // counter names from column 2 on
+    for (const char *f = p, *c = p; c <= nl; ++c) {
+        if (c < nl && *c != ',') continue;
+        const char *e = c > f && c[-1] == '\r' ? c - 1 : c;
+        if (col++ >= 2 && nctr < SINK_MAX_CTR) {
+            size_t len = (size_t)(e - f) < SINK_CTR_NAME ? (size_t)(e - f) : SINK_CTR_NAME;
+            memcpy(ctr_name[nctr], f, len);
+            ctr_name[nctr++][len] = 0;
+        }
+        f = c + 1;
+    }
+    for (p = nl + 1; p < end; ) {
+        uint64_t bytes, t;
+        const char *q = parse_u64(p, end, &bytes);
+        if (q == p || q >= end || *q != ',') {             // blank or junk line
+            const char *e = memchr(p, '\n', (size_t)(end - p));
+            p = e ? e + 1 : end;
+            continue;
+        }
+        q = parse_u64(q + 1, end, &t);
+        struct acc *a = acc_for(bytes);
+        a->hist[sink_bucket(t)]++;
+        a->n++;
+        a->sum += t;
+        if (t < a->min) a->min = t;
+        if (t > a->max) a->max = t;
+        for (unsigned c = 0; c < nctr && q < end && *q == ','; ++c) {
+            uint64_t v;
+            q = parse_u64(q + 1, end, &v);
+            a->ctr_sum[c] += v;
+        }
+        if (nctr) a->ctr_n++;
+        const char *e = memchr(q, '\n', (size_t)(end - q));
+        p = e ? e + 1 : end;
+    }
+    return 0;
+}
+
+static int load_bin(const char *p, const char *end) {
+    const char *start = p;
+    while (p < end) {
+        struct sink_hdr h;
+        size_t hsz = sizeof(h);
+        if ((size_t)(end - p) < hsz - 8 || memcmp(p, SINK_MAGIC, 4)) {
+            fprintf(stderr, "bad record at offset %td\n", p - start);
+            return -1;
+        }
+        memset(&h, 0, sizeof(h));
+        memcpy(&h, p, hsz - 8);
+        if (h.version >= 2) memcpy(&h, p, hsz);
+        else hsz -= 8;                                      // v1: no nctr / reserved
+        if (h.sub_bits != SINK_SUB_BITS) {
+            fprintf(stderr, "record uses %u sub-bucket bits, this build %d\n", h.sub_bits, SINK_SUB_BITS);
+            return -1;
+        }
+        size_t need = hsz + h.nbuckets * (sizeof(uint32_t) + sizeof(uint64_t)) + h.kept * sizeof(uint32_t);
+        if (h.nctr) need += h.nctr * SINK_CTR_NAME + h.kept * (1 + h.nctr) * sizeof(uint64_t);
+        if ((size_t)(end - p) < need) { fprintf(stderr, "truncated record\n"); return -1; }
+        p += hsz;
+
+        struct acc *a = acc_for(h.bytes);
+        const char *idx = p, *cnt = p + h.nbuckets * sizeof(uint32_t);
+        for (uint32_t i = 0; i < h.nbuckets; ++i) {
+            uint32_t b; uint64_t c;
+            memcpy(&b, idx + i * sizeof(b), sizeof(b));
+            memcpy(&c, cnt + i * sizeof(c), sizeof(c));
+            if (b < SINK_BUCKETS) a->hist[b] += c;
+        }
+        p = cnt + h.nbuckets * sizeof(uint64_t);
+        if (h.count) {
+            a->n += h.count;
+            if (h.min < a->min) a->min = h.min;
+            if (h.max > a->max) a->max = h.max;
+        }
+        if (h.kept == h.count) {
+            for (uint64_t i = 0; i < h.kept; ++i) {
+                uint32_t v;
+                memcpy(&v, p + i * sizeof(v), sizeof(v));
+                a->sum += v;
+            }
+        } else {
+            a->exact_sum = 0;
+        }
+        p += h.kept * sizeof(uint32_t);
+        if (h.nctr) {
+            unsigned nc = h.nctr < SINK_MAX_CTR ? h.nctr : SINK_MAX_CTR;
+            if (!nctr) {
+                nctr = nc;
+                for (unsigned c = 0; c < nc; ++c) memcpy(ctr_name[c], p + c * SINK_CTR_NAME, SINK_CTR_NAME);
+            }
+            p += h.nctr * SINK_CTR_NAME;
+            for (uint64_t r = 0; r < h.kept; ++r)
+                for (unsigned c = 0; c < nc && c < nctr; ++c) {
+                    uint64_t v;
+                    memcpy(&v, p + (r * (1 + h.nctr) + 1 + c) * sizeof(v), sizeof(v));
+                    a->ctr_sum[c] += v;
+                }
+            a->ctr_n += h.kept;
+            p += h.kept * (1 + h.nctr) * sizeof(uint64_t);
+        }
+    }
+    return 0;
+}
+
+// ---------- output ----------
+
+static void ascii_hist(const struct acc *a, const struct summary *s) {
+    double lo = (double)a->min, hi = s->q[6];               // p0 .. p99, as in the notebook
+    if (hi <= lo) hi = lo + 1;
+    double bin[HIST_BINS] = { 0 }, w = (hi - lo) / HIST_BINS, top = 0;
+    for (unsigned i = 0; i < SINK_BUCKETS; ++i) {           // spread each bucket over the bins
+        if (!a->hist[i]) continue;
+        double blo = (double)sink_bucket_lo(i), bhi = (double)bucket_hi(i);
+        if (blo < (double)a->min) blo = (double)a->min;
+        if (bhi > (double)a->max + 1) bhi = (double)a->max + 1;
+        if (blo >= hi) continue;
+        for (int k = (int)((blo - lo) / w); k < HIST_BINS; ++k) {
+            double x0 = lo + k * w, x1 = x0 + w;
+            double ov = (bhi < x1 ? bhi : x1) - (blo > x0 ? blo : x0);
+            if (ov <= 0) { if (x0 >= bhi) break; continue; }
+            bin[k] += (double)a->hist[i] * ov / (bhi - blo);
+        }
+    }
+    for (int k = 0; k < HIST_BINS; ++k) if (bin[k] > top) top = bin[k];
+    printf("\n%" PRIu64 " B: ticks, p0..p99\n", a->bytes);
+    for (int k = 0; k < HIST_BINS; ++k) {
+        int len = top > 0 ? (int)(bin[k] / top * HIST_WIDTH + 0.5) : 0;
+        printf("%10.0f |%.*s %.0f\n", lo + k * w,
+               len, "############################################################", bin[k]);
+    }
+}
+
+static void write_gnuplot(const char *prefix, const struct summary *sum) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s.dat", prefix);
+    FILE *f = fopen(path, "w");
+    if (!f) { perror(path); return; }
+    fprintf(f, "# bytes mean p1 p25 p50 p75 p99\n");
+    for (int i = 0; i < naccs; ++i)
+        fprintf(f, "%" PRIu64 " %.2f %.1f %.1f %.1f %.1f %.1f\n", accs[i].bytes, sum[i].mean,
+                sum[i].q[0], sum[i].q[2], sum[i].q[3], sum[i].q[4], sum[i].q[6]);
+    fclose(f);
+
+    snprintf(path, sizeof(path), "%s_hist.dat", prefix);
+    if (!(f = fopen(path, "w"))) { perror(path); return; }
+    for (int i = 0; i < naccs; ++i) {                       // one block per size, density per tick
+        fprintf(f, "# %" PRIu64 " B\n", accs[i].bytes);
+        for (unsigned b = 0; b < SINK_BUCKETS; ++b)
+            if (accs[i].hist[b] && (double)sink_bucket_lo(b) <= sum[i].q[6])
+                fprintf(f, "%" PRIu64 " %.6g\n", sink_bucket_lo(b),
+                        (double)accs[i].hist[b] / (double)(bucket_hi(b) - sink_bucket_lo(b)));
+        fprintf(f, "\n\n");
+    }
+    fclose(f);
+
+    snprintf(path, sizeof(path), "%s.gp", prefix);
+    if (!(f = fopen(path, "w"))) { perror(path); return; }
+    fprintf(f, "set terminal pngcairo size 1200,800\n"
+               "set logscale x 2\nset logscale y 10\nset grid\n"
+               "set xlabel 'Size (Bytes)'\nset ylabel 'Time (ticks)'\n"
+               "set output '%s_mean.png'\n"
+               "plot '%s.dat' using 1:2 with linespoints title 'mean', "
+               "'' using 1:5 with linespoints title 'p50'\n"
+               "set output '%s_box.png'\nset boxwidth 0.2 relative\n"
+               "plot '%s.dat' using 1:4:3:7:6 with candlesticks whiskerbars title 'p1/p25/p75/p99', "
+               "'' using 1:5:5:5:5 with candlesticks lt -1 notitle\n"
+               "unset logscale\nset ylabel 'samples per tick'\nset xlabel 'Time (ticks)'\n",
+            prefix, prefix, prefix, prefix);
+    for (int i = 0; i < naccs; ++i)
+        fprintf(f, "set output '%s_hist_%" PRIu64 ".png'\n"
+                   "plot '%s_hist.dat' index %d using 1:2 with steps title '%" PRIu64 " B'\n",
+                prefix, accs[i].bytes, prefix, i, accs[i].bytes);
+    fclose(f);
+    printf("wrote %s.dat, %s_hist.dat, %s.gp\n", prefix, prefix, prefix);
+}
+
+int main(int ac, char **av) {
+    double trim = 0.05;
+    const char *csv_path = NULL, *json_path = NULL, *gp_prefix = NULL;
+    int want_hist = 0, opt;
+    while ((opt = getopt(ac, av, "t:o:j:Hg:")) != -1) {
+        switch (opt) {
+        case 't': trim = atof(optarg); break;
+        case 'o': csv_path = optarg; break;
+        case 'j': json_path = optarg; break;
+        case 'H': want_hist = 1; break;
+        case 'g': gp_prefix = optarg; break;
+        default:  goto usage;
+        }
+    }
+    if (trim < 0 || trim >= 0.5 || optind + 1 < ac) goto usage;
+    const char *in_path = optind < ac ? av[optind] : "results.bin";
+
+    int fd = open(in_path, O_RDONLY);
+    if (fd < 0) { perror(in_path); return 1; }
+    struct stat st;
+    if (fstat(fd, &st)) { perror("fstat"); return 1; }
+    if (st.st_size == 0) { fprintf(stderr, "%s is empty\n", in_path); return 1; }
+    const char *p = (const char *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) { perror("mmap"); return 1; }
+    madvise((void *)p, (size_t)st.st_size, MADV_SEQUENTIAL);
+    const char *end = p + st.st_size;
+    int bin = st.st_size >= 4 && !memcmp(p, SINK_MAGIC, 4);
+    if (bin ? load_bin(p, end) : load_csv(p, end)) return 1;
+    munmap((void *)p, (size_t)st.st_size);
+    close(fd);
+
+    static struct summary sum[MAX_SIZES];
+    printf("%s: %s, %d sizes\n", in_path, bin ? "SNK1 binary" : "CSV", naccs);
+    printf("%9s %10s %10s %10s", "size", "n", "mean", "trim");
+    for (int k = 0; k < NQ; ++k) printf(" %8s", qname[k]);
+    printf(" %8s %7s %7s  modes\n", "max", "out<", "out>");
+    for (int i = 0; i < naccs; ++i) {
+        const struct acc *a = &accs[i];
+        summarize(a, trim, &sum[i]);
+        printf("%9" PRIu64 " %10" PRIu64 " %10.1f%s%10.1f", a->bytes, a->n, sum[i].mean,
+               a->exact_sum ? " " : "~", sum[i].trim);
+        for (int k = 0; k < NQ; ++k) printf(" %8.0f", sum[i].q[k]);
+        printf(" %8" PRIu64 " %7" PRIu64 " %7" PRIu64 " ", a->max, sum[i].out_lo, sum[i].out_hi);
+        for (int m = 0; m < sum[i].nmodes; ++m) printf(" %.0f", sum[i].mode[m]);
+        printf("\n");
+        if (nctr && a->ctr_n) {
+            printf("%9s per sample:", "");
+            for (unsigned c = 0; c < nctr; ++c)
+                printf(" %s=%.1f", ctr_name[c], (double)a->ctr_sum[c] / (double)a->ctr_n);
+            printf("\n");
+        }
+    }
+    printf("(trimmed mean drops %.0f%% at each end; ~ = mean from histogram, ring did not keep "
+           "every sample)\n", 100 * trim);
+    if (want_hist)
+        for (int i = 0; i < naccs; ++i) ascii_hist(&accs[i], &sum[i]);
+
+    if (csv_path) {
+        FILE *f = fopen(csv_path, "w");
+        if (!f) { perror(csv_path); return 1; }
+        fprintf(f, "Size(Bytes),N,Mean,TrimMean,Min");
+        for (int k = 0; k < NQ; ++k) fprintf(f, ",%s", qname[k]);
+        fprintf(f, ",Max,Mode1,Mode2,Mode3,OutliersLow,OutliersHigh");
+        for (unsigned c = 0; c < nctr; ++c) fprintf(f, ",%s", ctr_name[c]);
+        fprintf(f, "\n");
+        for (int i = 0; i < naccs; ++i) {
+            const struct acc *a = &accs[i];
+            fprintf(f, "%" PRIu64 ",%" PRIu64 ",%.2f,%.2f,%" PRIu64, a->bytes, a->n, sum[i].mean,
+                    sum[i].trim, a->n ? a->min : 0);
+            for (int k = 0; k < NQ; ++k) fprintf(f, ",%.1f", sum[i].q[k]);
+            fprintf(f, ",%" PRIu64, a->max);
+            for (int m = 0; m < MAX_MODES; ++m)
+                m < sum[i].nmodes ? fprintf(f, ",%.1f", sum[i].mode[m]) : fprintf(f, ",");
+            fprintf(f, ",%" PRIu64 ",%" PRIu64, sum[i].out_lo, sum[i].out_hi);
+            for (unsigned c = 0; c < nctr; ++c)
+                fprintf(f, ",%.2f", a->ctr_n ? (double)a->ctr_sum[c] / (double)a->ctr_n : 0.0);
+            fprintf(f, "\n");
+        }
+        fclose(f);
+        printf("wrote %s\n", csv_path);
+    }
+    if (json_path) {
+        FILE *f = fopen(json_path, "w");
+        if (!f) { perror(json_path); return 1; }
+        fprintf(f, "{\n  \"source\": \"%s\",\n  \"trim\": %.3f,\n  \"sizes\": [", in_path, trim);
+        for (int i = 0; i < naccs; ++i) {
+            const struct acc *a = &accs[i];
+            fprintf(f, "%s\n    {\"bytes\": %" PRIu64 ", \"n\": %" PRIu64 ", \"mean\": %.2f, "
+                       "\"mean_exact\": %s, \"trimmed_mean\": %.2f, \"min\": %" PRIu64
+                       ", \"max\": %" PRIu64 ",\n     \"percentiles\": {",
+                    i ? "," : "", a->bytes, a->n, sum[i].mean, a->exact_sum ? "true" : "false",
+                    sum[i].trim, a->n ? a->min : 0, a->max);
+            for (int k = 0; k < NQ; ++k)
+                fprintf(f, "%s\"%s\": %.1f", k ? ", " : "", qname[k], sum[i].q[k]);
+            fprintf(f, "},\n     \"modes\": [");
+            for (int m = 0; m < sum[i].nmodes; ++m) fprintf(f, "%s%.1f", m ? ", " : "", sum[i].mode[m]);
+            fprintf(f, "], \"outliers_low\": %" PRIu64 ", \"outliers_high\": %" PRIu64,
+                    sum[i].out_lo, sum[i].out_hi);
+            if (nctr && a->ctr_n) {
+                fprintf(f, ",\n     \"counters_per_sample\": {");
+                for (unsigned c = 0; c < nctr; ++c)
+                    fprintf(f, "%s\"%s\": %.2f", c ? ", " : "", ctr_name[c],
+                            (double)a->ctr_sum[c] / (double)a->ctr_n);
+                fprintf(f, "}");
+            }
+            fprintf(f, "}");
+        }
+        fprintf(f, "\n  ]\n}\n");
+        fclose(f);
+        printf("wrote %s\n", json_path);
+    }
+    if (gp_prefix) write_gnuplot(gp_prefix, sum);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-t trim] [-o summary.csv] [-j summary.json] [-H] [-g prefix] [file]\n",
+            av[0]);
+    return 1;
+}
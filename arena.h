@@ -0,0 +1,219 @@
+// arena.h -- page-size-aware arenas with virtual->physical translation.
+//
+// The row-buffer probes used to pick partners by virtual offset (A+512,
+// buf+ROW_STRIDE, ...), which across 4 KiB pages says nothing about where
+// the lines sit in DRAM. An arena is one mmap() backed by 4 KiB pages, THP,
+// or hugetlbfs 2 MiB / 1 GiB pages; arena_pa() reads /proc/self/pagemap
+// and arena_partner() finds the line at a given *physical* distance, so
+// row-hit / row-conflict pairs are the same every run.
+//
+// PFNs in pagemap need CAP_SYS_ADMIN. Without it arena_pa() returns
+// ARENA_PA_NONE and arena_partner() only resolves partners inside one
+// backing page, which is still physically contiguous for 2M/1G/THP. THP is
+// only a request: an arena the kernel did not back entirely with huge
+// pages (THP "never", fragmentation) is demoted to 4k after faulting in.
+#ifndef ARENA_H
+#define ARENA_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "numa.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+#define ARENA_PA_NONE UINT64_MAX
+#define ARENA_SMALL   4096UL       // pagemap granularity
+
+enum arena_backing { ARENA_4K, ARENA_THP, ARENA_2M, ARENA_1G };
+
+__attribute__((unused))
+static const char *arena_backing_name[] = { "4k", "thp", "2m", "1g" };
+
+struct arena_pfn {
+    uint64_t pfn;
+    size_t   idx;                  // 4 KiB page index inside the arena
+};
+
+struct arena {
+    char  *base;
+    size_t bytes;
+    size_t page;                   // backing page size
+    enum arena_backing kind;
+    char  *map;                    // raw mapping (THP over-allocates)
+    size_t map_bytes;
+    int    pagemap_fd;
+    struct arena_pfn *rev;         // sorted by pfn, for arena_va()
+    size_t nrev;
+};
+
+static inline int arena_parse_backing(const char *s, enum arena_backing *out) {
+    for (int i = 0; i < 4; ++i)
+        if (!strcmp(s, arena_backing_name[i])) { *out = (enum arena_backing)i; return 0; }
+    return -1;
+}
+
+static inline size_t arena_page_size(enum arena_backing k) {
+    return k == ARENA_1G ? (1UL << 30) : k == ARENA_4K ? ARENA_SMALL : (2UL << 20);
+}
+
+static inline uint64_t arena_pa(const struct arena *a, const void *va) {
+    if (a->pagemap_fd < 0) return ARENA_PA_NONE;
+    uint64_t e;
+    off_t off = (off_t)((uintptr_t)va / ARENA_SMALL * sizeof(e));
+    if (pread(a->pagemap_fd, &e, sizeof(e), off) != sizeof(e)) return ARENA_PA_NONE;
+    uint64_t pfn = e & ((1ULL << 55) - 1);
+    if (!(e >> 63) || !pfn) return ARENA_PA_NONE;   // not present / PFN hidden
+    return pfn * ARENA_SMALL + ((uintptr_t)va & (ARENA_SMALL - 1));
+}
+
+// Bytes of [p, p + len) backed by transparent huge pages (AnonHugePages in
+// /proc/self/smaps), or -1 if smaps cannot be read.
+static inline long arena_thp_bytes(const char *p, size_t len) {
+    FILE *f = fopen("/proc/self/smaps", "r");
+    if (!f) return -1;
+    unsigned long lo = (unsigned long)(uintptr_t)p, hi = lo + len, s, e;
+    long kb, total = 0;
+    int in = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%lx-%lx ", &s, &e) == 2) in = s < hi && e > lo;
+        else if (in && sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) total += kb << 10;
+    }
+    fclose(f);
+    return total;
+}
+
+static inline int arena_cmp_pfn(const void *x, const void *y) {
+    uint64_t a = ((const struct arena_pfn *)x)->pfn, b = ((const struct arena_pfn *)y)->pfn;
+    return (a > b) - (a < b);
+}
+
+// Builds the pfn -> page reverse map. Returns 0 if PFNs are visible.
+static inline int arena_index(struct arena *a) {
+    size_t n = a->bytes / ARENA_SMALL;
+    free(a->rev);
+    a->rev = (struct arena_pfn *)malloc(n * sizeof(*a->rev));
+    a->nrev = 0;
+    if (!a->rev) return -1;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t pa = arena_pa(a, a->base + i * ARENA_SMALL);
+        if (pa == ARENA_PA_NONE) { a->nrev = 0; return -1; }
+        a->rev[a->nrev++] = (struct arena_pfn){ pa / ARENA_SMALL, i };
+    }
+    qsort(a->rev, a->nrev, sizeof(*a->rev), arena_cmp_pfn);
+    return 0;
+}
+
+// Like arena_alloc(), with the pages bound to NUMA node `node` (numa.h)
+// before they are first touched; node < 0 keeps the thread's policy.
+static inline int arena_alloc_node(struct arena *a, size_t bytes, enum arena_backing kind,
+                                   int node) {
+    memset(a, 0, sizeof(*a));
+    a->pagemap_fd = -1;
+    a->kind = kind;
+    a->page = arena_page_size(kind);
+    a->bytes = (bytes + a->page - 1) & ~(a->page - 1);
+
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (kind == ARENA_2M) flags |= MAP_HUGETLB | MAP_HUGE_2MB;
+    if (kind == ARENA_1G) flags |= MAP_HUGETLB | MAP_HUGE_1GB;
+    a->map_bytes = a->bytes + (kind == ARENA_THP ? a->page : 0);
+    a->map = (char *)mmap(NULL, a->map_bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (a->map == MAP_FAILED) { perror("mmap arena"); a->map = NULL; return -1; }
+
+    a->base = a->map;
+    if (kind == ARENA_THP) {        // 2 MiB-align so whole huge pages fit
+        a->base = (char *)(((uintptr_t)a->map + a->page - 1) & ~(uintptr_t)(a->page - 1));
+        if (madvise(a->base, a->bytes, MADV_HUGEPAGE)) perror("madvise(MADV_HUGEPAGE)");
+    } else if (kind == ARENA_4K) {
+        madvise(a->base, a->bytes, MADV_NOHUGEPAGE);
+    }
+    if (node >= 0) numa_mbind(a->base, a->bytes, node);
+    for (size_t i = 0; i < a->bytes; i += ARENA_SMALL) a->base[i] = (char)i;
+    mlock(a->base, a->bytes);       // best effort: keep the PFNs stable
+    if (kind == ARENA_THP) {        // in-page contiguity is only real on huge pages
+        long huge = arena_thp_bytes(a->base, a->bytes);
+        if (huge < 0 || (size_t)huge < a->bytes) {
+            fprintf(stderr, "arena: %ld of %zu MiB on transparent huge pages, treating it as 4k\n",
+                    huge < 0 ? 0 : huge >> 20, a->bytes >> 20);
+            a->kind = ARENA_4K;
+            a->page = ARENA_SMALL;
+        }
+    }
+
+    a->pagemap_fd = open("/proc/self/pagemap", O_RDONLY);
+    arena_index(a);
+    return 0;
+}
+
+// Maps `bytes` (rounded up to the backing page) and faults every page in.
+// Returns 0 on success, -1 if the backing is unavailable (e.g. no hugetlbfs
+// pages reserved); perror() says why.
+static inline int arena_alloc(struct arena *a, size_t bytes, enum arena_backing kind) {
+    return arena_alloc_node(a, bytes, kind, -1);
+}
+
+static inline void arena_free(struct arena *a) {
+    if (a->map) { munlock(a->base, a->bytes); munmap(a->map, a->map_bytes); }
+    if (a->pagemap_fd >= 0) close(a->pagemap_fd);
+    free(a->rev);
+    memset(a, 0, sizeof(*a));
+    a->pagemap_fd = -1;
+}
+
+static inline int arena_has_pa(const struct arena *a) { return a->nrev != 0; }
+
+// Virtual address of physical address `pa` inside the arena, or NULL.
+static inline char *arena_va(const struct arena *a, uint64_t pa) {
+    struct arena_pfn key = { pa / ARENA_SMALL, 0 };
+    struct arena_pfn *hit = (struct arena_pfn *)bsearch(&key, a->rev, a->nrev,
+                                                        sizeof(key), arena_cmp_pfn);
+    if (!hit) return NULL;
+    return a->base + hit->idx * ARENA_SMALL + (pa & (ARENA_SMALL - 1));
+}
+
+// The line at physical distance `delta` from `va`, or NULL if that frame
+// is not part of the arena. Falls back to backing-page contiguity when
+// PFNs are not visible.
+static inline char *arena_partner(const struct arena *a, const char *va, int64_t delta) {
+    if (arena_has_pa(a)) {
+        uint64_t pa = arena_pa(a, va);
+        if (pa == ARENA_PA_NONE) return NULL;
+        return arena_va(a, pa + (uint64_t)delta);
+    }
+    uintptr_t off = (uintptr_t)(va - a->base);
+    uintptr_t page_lo = off & ~(uintptr_t)(a->page - 1);
+    int64_t to = (int64_t)off + delta;
+    if (to < (int64_t)page_lo || to >= (int64_t)(page_lo + a->page)) return NULL;
+    return a->base + to;
+}
+
+// Length of the physically contiguous run starting at `va` (whole pages).
+static inline size_t arena_contig(const struct arena *a, const char *va) {
+    if (!arena_has_pa(a))
+        return a->page - ((uintptr_t)(va - a->base) & (a->page - 1));
+    uint64_t pa = arena_pa(a, va);
+    const char *p = va;
+    size_t run = ARENA_SMALL - ((uintptr_t)va & (ARENA_SMALL - 1));
+    while (p + run < a->base + a->bytes && arena_pa(a, p + run) == pa + run)
+        run += ARENA_SMALL;
+    return run;
+}
+
+#endif // ARENA_H
@@ -0,0 +1,302 @@
+// bankmap.c -- reverse-engineer the DRAM bank address functions with time_ABA.
+//
+// openrow_test.c keeps only the min and max median of a linear scan. Here
+// the same A->B->A timing is used as a same-bank oracle:
+//   1. draw a pool of random lines from a (preferably hugepage) arena;
+//   2. calibrate the conflict threshold from random pairs (largest gap in
+//      the upper half of the sorted medians);
+//   3. cluster the pool into same-bank conflict sets;
+//   4. search XOR masks whose parity is constant inside every set, and keep
+//      a GF(2) basis of them -> bank/rank/channel functions;
+//   5. flip single physical bits (compensated to stay in the same bank)
+//      to split the remaining bits into row and column bits.
+// Each pair is sampled adaptively (sign test on batches of ABA_BATCH), so
+// clear cases stop after a handful of samples instead of TRIALS=200.
+//
+// usage: ./bankmap [-p 4k|thp|2m|1g] [-m arena_MiB] [-n pool] [-s seed] [-o dram_map.txt]
+// Needs root (pagemap PFNs) for full physical addresses; without them only
+// the bits below the backing page size can be recovered.
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <math.h>
+#include "arena.h"
+#include "rowprobe.h"
+#include "dram_map.h"
+
+#define ARENA_MB_DEFAULT 1024
+#define POOL_DEFAULT     2048
+#define CAL_PAIRS        512
+#define CAL_TRIALS       11
+#define ABA_BATCH        5
+#define ABA_MAX          45      // adaptive cap per pair (vs TRIALS=200)
+#define MIN_SET          4       // smaller clusters are treated as noise
+#define MAX_SETS         512
+#define MAX_FUNC_BITS    6       // max popcount of a candidate XOR mask
+#define LOW_BIT          6       // below this is the cache line offset
+#define SET_TOLERANCE    0.05    // fraction of set members allowed to disagree
+
+struct line { char *va; uint64_t pa; };
+
+static struct arena ar;
+static size_t span;              // bytes whose physical offsets we know
+static long total_samples;
+
+static uint64_t pa_of(const char *va) {
+    return arena_has_pa(&ar) ? arena_pa(&ar, va) : (uint64_t)(va - ar.base);
+}
+
+static char *va_of(uint64_t pa) {
+    if (arena_has_pa(&ar)) return arena_va(&ar, pa);
+    return pa < span ? ar.base + pa : NULL;
+}
+
+static uint64_t rng_state = 88172645463325252ULL;
+static uint64_t rng(void) {      // xorshift64
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Adaptive same-bank test: take ABA_BATCH samples at a time and stop as soon
+// as the count above `thr` is more than ~2 sigma away from a coin flip.
+static int conflicts(const char *A, const char *B, uint64_t thr) {
+    int n = 0, above = 0;
+    (void)aba_once(A, B);        // TLB / page walk warmup, not counted
+    while (n < ABA_MAX) {
+        for (int i = 0; i < ABA_BATCH; ++i, ++n) above += aba_once(A, B) > thr;
+        if (fabs(above - n / 2.0) > sqrt((double)n)) break;
+    }
+    total_samples += n + 1;
+    return above * 2 > n;
+}
+
+// Threshold between "no conflict" and "conflict" medians.
+static uint64_t calibrate(struct line *pool, int npool) {
+    static uint64_t med[CAL_PAIRS];
+    for (int i = 0; i < CAL_PAIRS; ++i) {
+        struct line *a = &pool[rng() % npool], *b = &pool[rng() % npool];
+        med[i] = time_ABA_n(a->va, b->va, CAL_TRIALS);
+        total_samples += CAL_TRIALS + ABA_WARMUP;
+    }
+    qsort(med, CAL_PAIRS, sizeof(uint64_t), cmp_u64);
+    int cut = CAL_PAIRS / 2;
+    for (int i = CAL_PAIRS / 2; i < CAL_PAIRS - CAL_PAIRS / 200 - 1; ++i)
+        if (med[i + 1] - med[i] > med[cut + 1] - med[cut]) cut = i;
+    uint64_t thr = (med[cut] + med[cut + 1]) / 2;
+    printf("calibration: median of pairs p50=%" PRIu64 " p99=%" PRIu64
+           ", gap %" PRIu64 "->%" PRIu64 ", threshold %" PRIu64 "\n",
+           med[CAL_PAIRS / 2], med[CAL_PAIRS * 99 / 100], med[cut], med[cut + 1], thr);
+    if (med[cut + 1] - med[cut] < med[cut] / 20)
+        printf("warning: conflict timings are not clearly bimodal; results may be noise\n");
+    return thr;
+}
+
+// Splits the pool into same-bank sets. Returns the number of sets; set k is
+// members[start[k] .. start[k+1]).
+static int cluster(struct line *pool, int npool, uint64_t thr,
+                   struct line *members, int *start) {
+    static char used[1 << 20];
+    int nsets = 0, nm = 0;
+    memset(used, 0, (size_t)npool);
+    for (int b = 0; b < npool && nsets < MAX_SETS; ++b) {
+        if (used[b]) continue;
+        used[b] = 1;
+        int first = nm;
+        members[nm++] = pool[b];
+        for (int i = b + 1; i < npool; ++i)
+            if (!used[i] && conflicts(pool[b].va, pool[i].va, thr)) members[nm++] = pool[i];
+        // Drop members that do not also conflict with a second member.
+        if (nm - first >= MIN_SET) {
+            int keep = first + 2;
+            for (int i = first + 2; i < nm; ++i)
+                if (conflicts(members[first + 1].va, members[i].va, thr))
+                    members[keep++] = members[i];
+            nm = keep;
+        }
+        if (nm - first < MIN_SET) { nm = first; continue; }
+        for (int i = first; i < nm; ++i)
+            for (int j = b; j < npool; ++j)
+                if (pool[j].va == members[i].va) used[j] = 1;
+        start[nsets++] = first;
+    }
+    start[nsets] = nm;
+    return nsets;
+}
+
+// Parity of `mask` is constant inside (almost) every set and not constant
+// across all of them.
+static int mask_fits(uint64_t mask, const struct line *m, const int *start, int nsets) {
+    int bad = 0, total = start[nsets], seen[2] = {0, 0};
+    for (int k = 0; k < nsets; ++k) {
+        int ones = 0, n = start[k + 1] - start[k];
+        for (int i = start[k]; i < start[k + 1]; ++i)
+            ones += __builtin_parityll(m[i].pa & mask);
+        int maj = ones * 2 > n;
+        bad += maj ? n - ones : ones;
+        if (bad > total * SET_TOLERANCE) return 0;
+        seen[maj] = 1;
+    }
+    return seen[0] && seen[1];
+}
+
+// GF(2) elimination: piv[b] is the basis vector whose msb is b (or 0).
+// Returns the residue of `v`; non-zero means `v` is independent.
+static uint64_t reduce(uint64_t v, const uint64_t *piv) {
+    for (int b = 63; b >= 0; --b)
+        if ((v >> b & 1) && piv[b]) v ^= piv[b];
+    return v;
+}
+
+static int solve_funcs(uint64_t cand_bits, const struct line *m, const int *start,
+                       int nsets, struct dram_map *map) {
+    int bits[64], nb = 0;
+    for (int b = LOW_BIT; b < 64; ++b) if (cand_bits >> b & 1) bits[nb++] = b;
+    uint64_t piv[64] = {0};       // reduced copies, for independence tests
+    // Enumerate masks by increasing popcount so the basis stays sparse.
+    for (int k = 1; k <= MAX_FUNC_BITS && map->nfuncs < DRAM_MAX_FUNCS; ++k) {
+        int idx[MAX_FUNC_BITS];
+        for (int i = 0; i < k; ++i) idx[i] = i;
+        while (k <= nb) {
+            uint64_t mask = 0;
+            for (int i = 0; i < k; ++i) mask |= 1ULL << bits[idx[i]];
+            if (mask_fits(mask, m, start, nsets)) {
+                uint64_t r = reduce(mask, piv);
+                if (r) {
+                    piv[63 - __builtin_clzll(r)] = r;
+                    map->masks[map->nfuncs++] = mask;
+                    if (map->nfuncs == DRAM_MAX_FUNCS) break;
+                }
+            }
+            int i = k - 1;      // next combination
+            while (i >= 0 && idx[i] == nb - k + i) --i;
+            if (i < 0) break;
+            idx[i]++;
+            for (int j = i + 1; j < k; ++j) idx[j] = idx[j - 1] + 1;
+        }
+    }
+    return map->nfuncs;
+}
+
+// Classifies each candidate bit as row (flip => conflict) or column.
+static void row_col_bits(uint64_t cand_bits, const struct line *pool, int npool,
+                         uint64_t thr, struct dram_map *map) {
+    map->row_lo = map->col_lo = 64;
+    map->row_hi = map->col_hi = -1;
+    printf("bit classification (r=row, c=column, ?=no partner in arena):\n  ");
+    for (int b = LOW_BIT; b < 64; ++b) {
+        if (!(cand_bits >> b & 1)) continue;
+        char kind = '?';
+        for (int t = 0; t < 16 && kind == '?'; ++t) {
+            const struct line *x = &pool[rng() % npool];
+            uint64_t pb = x->pa ^ (1ULL << b);
+            // Keep the bank index unchanged by also flipping one other bit.
+            if (dram_bank(map, pb) != dram_bank(map, x->pa)) {
+                int c;
+                for (c = LOW_BIT; c < 64; ++c) {
+                    if (c == b || !(cand_bits >> c & 1)) continue;
+                    if (dram_bank(map, pb ^ (1ULL << c)) == dram_bank(map, x->pa)) break;
+                }
+                if (c == 64) break;
+                pb ^= 1ULL << c;
+            }
+            char *y = va_of(pb);
+            if (!y) continue;
+            kind = conflicts(x->va, y, thr) ? 'r' : 'c';
+        }
+        printf("%d%c ", b, kind);
+        if (kind == 'r') {
+            if (b < map->row_lo) map->row_lo = b;
+            if (b > map->row_hi) map->row_hi = b;
+        } else if (kind == 'c') {
+            if (b < map->col_lo) map->col_lo = b;
+            if (b > map->col_hi) map->col_hi = b;
+        }
+    }
+    printf("\n");
+    if (map->row_hi < 0) map->row_lo = -1;
+    if (map->col_hi < 0) map->col_lo = -1;
+}
+
+int main(int ac, char **av) {
+    enum arena_backing backing = ARENA_THP;
+    size_t arena_mb = ARENA_MB_DEFAULT;
+    int npool = POOL_DEFAULT;
+    const char *out_path = DRAM_MAP_FILE;
+    int opt;
+    while ((opt = getopt(ac, av, "p:m:n:s:o:")) != -1) {
+        switch (opt) {
+        case 'p': if (arena_parse_backing(optarg, &backing)) goto usage; break;
+        case 'm': arena_mb = (size_t)atol(optarg); break;
+        case 'n': npool = atoi(optarg); break;
+        case 's': rng_state = strtoull(optarg, NULL, 0) | 1; break;
+        case 'o': out_path = optarg; break;
+        default:
+        usage:
+            fprintf(stderr, "usage: %s [-p 4k|thp|2m|1g] [-m arena_MiB] [-n pool] "
+                            "[-s seed] [-o dram_map.txt]\n", av[0]);
+            return 1;
+        }
+    }
+    if (npool < 2 * MIN_SET || npool > (1 << 20)) goto usage;
+
+    double t_start = now_sec();
+    if (arena_alloc(&ar, arena_mb << 20, backing) && arena_alloc(&ar, arena_mb << 20, ARENA_4K))
+        return 1;
+    span = arena_has_pa(&ar) ? ar.bytes : ar.page;
+    printf("arena: %zu MiB on %s pages; physical addresses %s\n", ar.bytes >> 20,
+           arena_backing_name[ar.kind],
+           arena_has_pa(&ar) ? "from pagemap" : "hidden, using offsets inside one page");
+
+    // 1. pool of random lines (distinct by construction: one per slot)
+    struct line *pool = (struct line *)xalloc(CACHELINE, (size_t)npool * sizeof(*pool));
+    size_t slot = span / (size_t)npool & ~(size_t)(CACHELINE - 1);
+    if (slot < CACHELINE) { fprintf(stderr, "arena too small for pool\n"); return 1; }
+    uint64_t pa_or = 0, pa_and = ~0ULL;
+    for (int i = 0; i < npool; ++i) {
+        pool[i].va = ar.base + (size_t)i * slot + (rng() % (slot / CACHELINE)) * CACHELINE;
+        pool[i].pa = pa_of(pool[i].va);
+        pa_or |= pool[i].pa;
+        pa_and &= pool[i].pa;
+    }
+    uint64_t cand_bits = (pa_or ^ pa_and) & ~((1ULL << LOW_BIT) - 1);
+
+    // 2. threshold
+    struct dram_map map;
+    memset(&map, 0, sizeof(map));
+    map.threshold = calibrate(pool, npool);
+
+    // 3. same-bank sets
+    struct line *members = (struct line *)xalloc(CACHELINE, (size_t)npool * sizeof(*members));
+    static int start[MAX_SETS + 1];
+    int nsets = cluster(pool, npool, map.threshold, members, start);
+    printf("clustered %d of %d lines into %d conflict sets (%.2fs, %ld samples)\n",
+           start[nsets], npool, nsets, now_sec() - t_start, total_samples);
+    if (nsets < 2) {
+        fprintf(stderr, "not enough conflict sets to solve for bank functions\n");
+        return 1;
+    }
+
+    // 4. XOR functions
+    solve_funcs(cand_bits, members, start, nsets, &map);
+    printf("%d bank/rank/channel functions (expect ~log2(%d) = %.1f):\n",
+           map.nfuncs, nsets, log2((double)nsets));
+    for (int i = 0; i < map.nfuncs; ++i) {
+        printf("  f%-2d = 0x%-12" PRIx64 " bits", i, map.masks[i]);
+        for (int b = 0; b < 64; ++b) if (map.masks[i] >> b & 1) printf(" %d", b);
+        printf("\n");
+    }
+
+    // 5. row / column bits
+    row_col_bits(cand_bits, pool, npool, map.threshold, &map);
+    printf("row bits %d..%d, column bits %d..%d\n", map.row_lo, map.row_hi,
+           map.col_lo, map.col_hi);
+
+    if (!dram_map_save(&map, out_path)) printf("saved %s\n", out_path);
+    printf("done in %.2fs, %ld A->B->A samples\n", now_sec() - t_start, total_samples);
+
+    free(pool);
+    free(members);
+    arena_free(&ar);
+    return 0;
+}
@@ -0,0 +1,89 @@
+// bench.h -- helpers shared by the newer benchmark programs.
+//
+// Same idioms as hw1_test.c / openrow_test.c (64B lines, lfence+rdtscp,
+// page pre-touch), collected in one place so the multi-file tools do not
+// each carry their own copy. TSC reads and their calibration are in
+// timer.h.
+#ifndef BENCH_H
+#define BENCH_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <x86intrin.h>   // _mm_clflush, _mm_lfence, _mm_mfence, __rdtscp
+#include "timer.h"       // tsc_begin/tsc_end, now_sec
+
+#define CACHELINE 64
+#define PAGE      4096
+
+__attribute__((unused))
+static const int exps[] = {6,7,8,9,10,11,12,13,14,15,16,20,21};
+#define NEXPS ((int)(sizeof(exps)/sizeof(exps[0])))
+
+static inline void clflush_range(void *p, size_t len) {
+    uintptr_t a = (uintptr_t)p & ~(uintptr_t)(CACHELINE - 1);
+    uintptr_t e = (uintptr_t)p + len;
+    for (; a < e; a += CACHELINE) _mm_clflush((void*)a);
+    _mm_mfence();  // ensure flush completion
+}
+
+static inline void prefault_touch(char *buf, size_t bytes) {
+    // Page pre-touch to avoid page faults/zeroing during timing
+    for (size_t i = 0; i < bytes; i += PAGE) buf[i] = 1;
+    if (bytes > 0) buf[bytes-1] ^= 0;
+}
+
+static inline int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// 64B-aligned (or `align`-aligned) allocation; exits on failure like the
+// posix_memalign() call sites in hw1_test.c.
+static inline void *xalloc(size_t align, size_t bytes) {
+    void *p;
+    if (posix_memalign(&p, align, bytes)) { perror("posix_memalign"); exit(1); }
+    return p;
+}
+
+// Pins the calling thread to one CPU. Returns 0 on success.
+static inline int pin_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// Fills `cpus` with the CPUs this process may run on, in ascending order.
+static inline int allowed_cpus(int *cpus, int max) {
+    cpu_set_t set;
+    int n = 0;
+    if (sched_getaffinity(0, sizeof(set), &set)) return 0;
+    for (int c = 0; c < CPU_SETSIZE && n < max; ++c)
+        if (CPU_ISSET(c, &set)) cpus[n++] = c;
+    return n;
+}
+
+// Parses "0,2,4-7" into `cpus`; returns the count.
+static inline int parse_cpu_list(const char *s, int *cpus, int max) {
+    int n = 0;
+    while (*s && n < max) {
+        char *end;
+        long a = strtol(s, &end, 10), b = a;
+        if (end == s) break;
+        if (*end == '-') b = strtol(end + 1, &end, 10);
+        for (long c = a; c <= b && n < max; ++c) cpus[n++] = (int)c;
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+#endif // BENCH_H
@@ -0,0 +1,222 @@
+// blp.c -- bank-level parallelism: throughput into one bank vs many.
+//
+// openrow_test.c times one serialized A->B->A per pair. Here the same
+// conflict information drives a throughput test over two address sets of
+// the same size:
+//   same-bank: lines in one bank, each in a different row, so every access
+//              is a row conflict and the bank serializes them (tRC);
+//   spread:    lines in different banks, which the controller can overlap.
+// Each of -t pinned threads gets its own -n lines of each set and, for
+// ROUNDS rounds, issues independent loads to all of them, then flushes
+// them again (clflush + mfence, identical work in both cases). We report
+// aggregate GB/s, ns per access (inverse throughput) and ns per round
+// (how long a batch of n misses takes to drain).
+//
+// Sets come from the bank functions in dram_map.txt (bankmap.c) when that
+// file exists and the arena can supply them; otherwise from a time_ABA()
+// scan against A like openrow_test.c's, where "same-bank" = above the
+// midpoint between the fastest and slowest partner and "spread" = below it.
+// Without visible PFNs only the offset inside a backing page is physical,
+// so the map is used only if every bank function stays below the page size
+// (row bits above it are ignored). The fallback does not know whether two
+// fast partners share a bank with each other, so its spread set is only a
+// best case guess.
+//
+// usage: ./blp [-p 4k|thp|2m|1g] [-m arena_MiB] [-n lines] [-t threads] [-f dram_map.txt]
+#define _GNU_SOURCE
+#include <unistd.h>
+#include "arena.h"
+#include "rowprobe.h"
+#include "dram_map.h"
+
+#define ARENA_MB    256
+#define MAX_LINES   1024        // per set, all threads together
+#define MAX_THREADS 64
+#define ROUNDS      20000
+#define SCAN_STRIDE (64*1024)   // fallback scan, as in openrow_test.c
+
+struct worker {
+    pthread_t th;
+    int cpu;
+    char **lines;
+    int n;
+    pthread_barrier_t *start;
+    double t0, t1;
+};
+
+static struct arena ar;
+
+// Physical address, or without PFNs just the (physical) offset in the backing page.
+static uint64_t pa_of(const char *va) {
+    return arena_has_pa(&ar) ? arena_pa(&ar, va) : (uint64_t)(va - ar.base) & (ar.page - 1);
+}
+
+static void *hammer(void *arg) {
+    struct worker *w = (struct worker *)arg;
+    if (w->cpu >= 0 && pin_cpu(w->cpu)) fprintf(stderr, "warning: could not pin to cpu %d\n", w->cpu);
+    unsigned sum = 0;
+    for (int i = 0; i < w->n; ++i) clflush_range(w->lines[i], 1);
+    pthread_barrier_wait(w->start);
+    w->t0 = now_sec();
+    for (long r = 0; r < ROUNDS; ++r) {
+        for (int i = 0; i < w->n; ++i) sum += *(volatile unsigned char *)w->lines[i];
+        for (int i = 0; i < w->n; ++i) _mm_clflush(w->lines[i]);
+        _mm_mfence();
+    }
+    w->t1 = now_sec();
+    asm volatile("" :: "r"(sum));
+    return NULL;
+}
+
+// Runs `nthreads` workers over consecutive n-line slices of `set`.
+static void run(const char *label, char **set, int n, int nthreads, const int *cpus, int ncpus) {
+    static struct worker w[MAX_THREADS];
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, (unsigned)nthreads);
+    for (int i = 0; i < nthreads; ++i) {
+        w[i] = (struct worker){ .cpu = ncpus ? cpus[i % ncpus] : -1, .lines = set + i * n,
+                                .n = n, .start = &start };
+        if (pthread_create(&w[i].th, NULL, hammer, &w[i])) { perror("pthread_create"); exit(1); }
+    }
+    for (int i = 0; i < nthreads; ++i) pthread_join(w[i].th, NULL);
+    pthread_barrier_destroy(&start);
+
+    double first = w[0].t0, last = w[0].t1, round_ns = 0;
+    for (int i = 0; i < nthreads; ++i) {
+        if (w[i].t0 < first) first = w[i].t0;
+        if (w[i].t1 > last)  last  = w[i].t1;
+        round_ns += (w[i].t1 - w[i].t0) * 1e9 / ROUNDS / nthreads;
+    }
+    double accesses = (double)ROUNDS * n * nthreads;
+    double gbps = accesses * CACHELINE / (last - first) / 1e9;
+    printf("  %-10s %4d lines x %2d thr  %8.3f GB/s  %7.1f ns/access  %8.1f ns/round\n",
+           label, n, nthreads, gbps, (last - first) * 1e9 / accesses * nthreads, round_ns);
+}
+
+// Sets from the recovered bank functions: bank(A)'s rows, and one line per
+// other bank. Returns 0 if the map is usable and both sets filled up.
+static int sets_from_map(const struct dram_map *map, char **same, char **spread, int want) {
+    struct dram_map km = *map, *m = &km;
+    if (!arena_has_pa(&ar)) {           // only in-page bits are known
+        uint64_t known = ar.page - 1;
+        int top = __builtin_ctzll(ar.page) - 1;
+        for (int i = 0; i < m->nfuncs; ++i)
+            if (m->masks[i] & ~known) {
+                fprintf(stderr, "dram map: bank function 0x%" PRIx64 " needs PA bits above the %s page\n",
+                        m->masks[i], arena_backing_name[ar.kind]);
+                return -1;
+            }
+        if (m->row_hi > top) m->row_hi = top;
+        if (m->row_lo > top) m->row_lo = -1;
+    }
+    char *A = ar.base;
+    uint64_t pa_A = pa_of(A);
+    unsigned bank_A = dram_bank(m, pa_A);
+    uint64_t rows[MAX_LINES];
+    int ns = 0, nb = 0;
+    static unsigned char seen[1u << DRAM_MAX_FUNCS];
+    memset(seen, 0, sizeof(seen));
+    same[ns] = A; rows[ns++] = dram_row(m, pa_A);
+    spread[nb++] = A; seen[bank_A] = 1;
+    for (size_t off = PAGE; off < ar.bytes && (ns < want || nb < want); off += PAGE) {
+        char *p = ar.base + off;
+        uint64_t pa = pa_of(p);
+        if (pa == ARENA_PA_NONE) continue;
+        unsigned b = dram_bank(m, pa);
+        uint64_t row = dram_row(m, pa);
+        if (b == bank_A && ns < want) {
+            int dup = 0;
+            for (int i = 0; i < ns && !dup; ++i) dup = rows[i] == row;
+            if (!dup) { rows[ns] = row; same[ns++] = p; }
+        } else if (!seen[b] && nb < want) {
+            seen[b] = 1;
+            spread[nb++] = p;
+        }
+    }
+    if (ns < want || nb < want) {
+        fprintf(stderr, "dram map: found %d same-bank rows and %d banks, need %d each\n",
+                ns, nb, want);
+        return -1;
+    }
+    return 0;
+}
+
+// openrow_test.c-style fallback: classify SCAN_STRIDE partners of A.
+static int sets_from_scan(char **same, char **spread, int want) {
+    char *A = ar.base;
+    size_t ncand = ar.bytes / SCAN_STRIDE - 1;
+    uint64_t *med = (uint64_t *)xalloc(CACHELINE, ncand * sizeof(uint64_t));
+    uint64_t lo = UINT64_MAX, hi = 0;
+    for (size_t i = 0; i < ncand; ++i) {
+        med[i] = time_ABA(A, A + (i + 1) * SCAN_STRIDE);
+        if (med[i] < lo) lo = med[i];
+        if (med[i] > hi) hi = med[i];
+    }
+    uint64_t thr = (lo + hi) / 2;
+    int ns = 0, nb = 0;
+    same[ns++] = A;
+    for (size_t i = 0; i < ncand; ++i) {
+        char *p = A + (i + 1) * SCAN_STRIDE;
+        if (med[i] > thr && ns < want) same[ns++] = p;
+        else if (med[i] <= thr && nb < want) spread[nb++] = p;
+    }
+    free(med);
+    printf("scan: A->B->A medians %" PRIu64 "..%" PRIu64 " ticks, threshold %" PRIu64 "\n",
+           lo, hi, thr);
+    if (ns < want || nb < want) {
+        fprintf(stderr, "scan: found %d conflicting and %d non-conflicting partners, need %d each\n",
+                ns, nb, want);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int ac, char **av) {
+    enum arena_backing backing = ARENA_THP;
+    size_t arena_mb = ARENA_MB;
+    int n = 16, nthreads = 1;
+    const char *map_path = DRAM_MAP_FILE;
+    int opt;
+    while ((opt = getopt(ac, av, "p:m:n:t:f:")) != -1) {
+        switch (opt) {
+        case 'p': if (arena_parse_backing(optarg, &backing)) goto usage; break;
+        case 'm': arena_mb = (size_t)atol(optarg); break;
+        case 'n': n = atoi(optarg); break;
+        case 't': nthreads = atoi(optarg); break;
+        case 'f': map_path = optarg; break;
+        default:  goto usage;
+        }
+    }
+    if (n < 1 || nthreads < 1 || nthreads > MAX_THREADS || n * nthreads > MAX_LINES) goto usage;
+
+    int cpus[MAX_THREADS];
+    int ncpus = allowed_cpus(cpus, MAX_THREADS);
+    timer_init(1);
+    if (arena_alloc(&ar, arena_mb << 20, backing)) return 1;
+    memset(ar.base, 0xA5, ar.bytes);
+    printf("arena %zu MiB, %s pages, physical addresses %s\n", ar.bytes >> 20,
+           arena_backing_name[ar.kind], arena_has_pa(&ar) ? "visible" : "hidden (not root?)");
+
+    static char *same[MAX_LINES], *spread[MAX_LINES];
+    int want = n * nthreads;
+    struct dram_map m;
+    int have_map = !dram_map_load(&m, map_path);
+    if (have_map) printf("sets from %s (%d bank functions)\n", map_path, m.nfuncs);
+    if (!have_map || sets_from_map(&m, same, spread, want)) {
+        printf("%s; classifying partners of A by time_ABA()\n",
+               have_map ? "dram map unusable here" : "no dram map");
+        if (sets_from_scan(same, spread, want)) return 1;
+    }
+
+    printf("%d rounds per thread:\n", ROUNDS);
+    run("same-bank", same, n, nthreads, cpus, ncpus);
+    run("spread", spread, n, nthreads, cpus, ncpus);
+
+    arena_free(&ar);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-p 4k|thp|2m|1g] [-m arena_MiB] [-n lines] [-t threads] "
+                    "[-f dram_map.txt]\n  (-n x -t <= %d)\n", av[0], MAX_LINES);
+    return 1;
+}
@@ -0,0 +1,236 @@
+// c2c.c -- core-to-core cache-line transfer latency matrix.
+//
+// Every other harness runs on one core, but work handed between threads
+// moves through shared cache lines, and what that costs depends on where
+// the two threads sit: SMT siblings share L1, cores of one CCX share L3,
+// beyond that the line crosses the die or socket interconnect. For each
+// pair of CPUs (-c, default all allowed) the main thread pins itself to
+// the row CPU and a responder thread to the column CPU, and they bounce
+// one 64 B line (alone on a 128 B block, so the adjacent-line prefetcher
+// does not drag a neighbour along) three ways:
+//   cas    each side CASes the counter from the other side's value to its
+//          own (spinning on the CAS itself), so every step is an RFO
+//   flag   plain store / load: each side spins reading until the counter
+//          has the other side's value, then stores its own
+//   faa    both sides lock xadd the same counter flat out; ns per add of
+//          the row CPU, i.e. the cost of a contended atomic, not a hop
+// cas and flag report one-way latency, half of a round trip. Each point is
+// the median of SAMPLES batches of -r round trips after WARMUP. Only i < j
+// is measured and mirrored unless -a asks for both directions.
+//
+// The matrix is printed per method, then a summary per topology relation
+// (topo.h: smt, same-llc, same-die, same-pkg, cross-pkg) that says which
+// placements are cheap. -o writes one row per pair and method.
+//
+// usage: ./c2c [-c cpu_list] [-r rounds] [-a] [-o c2c.csv]
+#define _GNU_SOURCE
+#include <unistd.h>
+#include "bench.h"
+#include "topo.h"
+
+#define MAX_CPUS 256
+#define SAMPLES  9
+#define WARMUP   1000
+
+enum method { M_CAS, M_FLAG, M_FAA, NMETHOD };
+static const char *method_name[NMETHOD] = { "cas", "flag", "faa" };
+
+struct pingpong {
+    volatile uint64_t v;
+    char pad[2 * CACHELINE - sizeof(uint64_t)];
+} __attribute__((aligned(2 * CACHELINE)));
+
+struct responder {
+    pthread_t th;
+    int cpu;
+    enum method m;
+    long rounds;                // total, warm-up included
+    struct pingpong *line;
+    volatile int ready, stop;
+};
+
+static void *respond(void *arg) {
+    struct responder *r = (struct responder *)arg;
+    if (pin_cpu(r->cpu)) fprintf(stderr, "warning: could not pin responder to cpu %d\n", r->cpu);
+    volatile uint64_t *v = &r->line->v;
+    __atomic_store_n(&r->ready, 1, __ATOMIC_RELEASE);
+    switch (r->m) {
+    case M_CAS:
+        for (uint64_t i = 0; i < (uint64_t)r->rounds; ++i) {
+            uint64_t want = 2 * i + 1;
+            while (!__atomic_compare_exchange_n(v, &want, 2 * i + 2, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                want = 2 * i + 1;
+                _mm_pause();
+            }
+        }
+        break;
+    case M_FLAG:
+        for (uint64_t i = 0; i < (uint64_t)r->rounds; ++i) {
+            while (__atomic_load_n(v, __ATOMIC_ACQUIRE) != 2 * i + 1) _mm_pause();
+            __atomic_store_n(v, 2 * i + 2, __ATOMIC_RELEASE);
+        }
+        break;
+    default:
+        while (!__atomic_load_n(&r->stop, __ATOMIC_RELAXED)) __atomic_fetch_add(v, 1, __ATOMIC_ACQ_REL);
+        break;
+    }
+    return NULL;
+}
+
+// The initiator's side; returns ns per one-way hop (cas, flag) or per
+// add (faa), median over SAMPLES batches of `batch` rounds.
+static double initiate(struct responder *r, long batch) {
+    volatile uint64_t *v = &r->line->v;
+    uint64_t t[SAMPLES], mark = 0;
+    uint64_t i = 0;
+    while (!__atomic_load_n(&r->ready, __ATOMIC_ACQUIRE)) _mm_pause();
+    for (int s = -1; s < SAMPLES; ++s) {            // s = -1 is the warm-up
+        uint64_t n = s < 0 ? WARMUP : (uint64_t)batch;
+        uint64_t t0 = tsc_begin();
+        switch (r->m) {
+        case M_CAS:
+            for (uint64_t end = i + n; i < end; ++i) {
+                uint64_t want = 2 * i;
+                while (!__atomic_compare_exchange_n(v, &want, 2 * i + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                    want = 2 * i;
+                    _mm_pause();
+                }
+            }
+            break;
+        case M_FLAG:
+            for (uint64_t end = i + n; i < end; ++i) {
+                __atomic_store_n(v, 2 * i + 1, __ATOMIC_RELEASE);
+                while (__atomic_load_n(v, __ATOMIC_ACQUIRE) != 2 * i + 2) _mm_pause();
+            }
+            break;
+        default:
+            for (uint64_t k = 0; k < n; ++k) mark += __atomic_fetch_add(v, 1, __ATOMIC_ACQ_REL);
+            break;
+        }
+        uint64_t t1 = tsc_end();
+        if (s >= 0) t[s] = t1 - t0;
+    }
+    asm volatile("" :: "r"(mark));
+    // cas/flag: the initiator waits for the responder's last reply too,
+    // so every batch is n full round trips
+    if (r->m != M_FAA) {
+        uint64_t last = 2 * i;
+        while (__atomic_load_n(v, __ATOMIC_ACQUIRE) != last) _mm_pause();
+    }
+    qsort(t, SAMPLES, sizeof(uint64_t), cmp_u64);
+    double per = ticks_ns((double)t[SAMPLES / 2]) / (double)batch;
+    return r->m == M_FAA ? per : per / 2;
+}
+
+static double measure(int a, int b, enum method m, long batch, struct pingpong *line) {
+    static struct responder r;
+    r = (struct responder){ .cpu = b, .m = m, .rounds = WARMUP + SAMPLES * batch, .line = line };
+    line->v = 0;
+    if (pin_cpu(a)) fprintf(stderr, "warning: could not pin to cpu %d\n", a);
+    if (pthread_create(&r.th, NULL, respond, &r)) { perror("pthread_create"); exit(1); }
+    double ns = initiate(&r, batch);
+    __atomic_store_n(&r.stop, 1, __ATOMIC_RELAXED);
+    pthread_join(r.th, NULL);
+    return ns;
+}
+
+int main(int ac, char **av) {
+    static int cpus[MAX_CPUS];
+    int ncpus = 0, all = 0, opt;
+    long batch = 2000;
+    const char *out_path = "c2c.csv";
+    while ((opt = getopt(ac, av, "c:r:ao:")) != -1) {
+        switch (opt) {
+        case 'c': ncpus = parse_cpu_list(optarg, cpus, MAX_CPUS); break;
+        case 'r': batch = atol(optarg); break;
+        case 'a': all = 1; break;
+        case 'o': out_path = optarg; break;
+        default:  goto usage;
+        }
+    }
+    if (batch < 1) goto usage;
+    if (!ncpus) ncpus = allowed_cpus(cpus, MAX_CPUS);
+    if (ncpus < 2) {
+        fprintf(stderr, "need at least two CPUs (have %d); -c 0,0 runs both threads on one CPU\n", ncpus);
+        return 1;
+    }
+    timer_init(1);
+
+    static struct cpu_topo topo[MAX_CPUS];
+    printf("%4s %5s %5s %5s %5s\n", "cpu", "core", "llc", "die", "pkg");
+    for (int i = 0; i < ncpus; ++i) {
+        topo_get(cpus[i], &topo[i]);
+        printf("%4d %5d %5d %5d %5d\n", cpus[i], topo[i].core, topo[i].llc, topo[i].die, topo[i].pkg);
+    }
+
+    struct pingpong *line = (struct pingpong *)xalloc(sizeof(struct pingpong), sizeof(struct pingpong));
+    static double ns[NMETHOD][MAX_CPUS][MAX_CPUS];
+    FILE *out = fopen(out_path, "w");
+    if (!out) { perror(out_path); return 1; }
+    fprintf(out, "CpuA,CpuB,Relation,Method,Ns\n");
+
+    for (int i = 0; i < ncpus; ++i) {
+        for (int j = all ? 0 : i + 1; j < ncpus; ++j) {
+            if (j == i) continue;
+            enum topo_rel rel = topo_relation(&topo[i], &topo[j]);
+            for (int m = 0; m < NMETHOD; ++m) {
+                ns[m][i][j] = measure(cpus[i], cpus[j], (enum method)m, batch, line);
+                if (!all) ns[m][j][i] = ns[m][i][j];
+                fprintf(out, "%d,%d,%s,%s,%.2f\n", cpus[i], cpus[j], topo_rel_name[rel],
+                        method_name[m], ns[m][i][j]);
+            }
+            printf("  cpu %3d -> %3d (%-9s) cas %7.1f  flag %7.1f  faa %7.1f ns\n", cpus[i], cpus[j],
+                   topo_rel_name[rel], ns[M_CAS][i][j], ns[M_FLAG][i][j], ns[M_FAA][i][j]);
+            fflush(stdout);
+        }
+    }
+
+    for (int m = 0; m < NMETHOD; ++m) {
+        printf("\n%s, ns %s (rows = initiator)\n     ", method_name[m],
+               m == M_FAA ? "per contended add" : "one way");
+        for (int j = 0; j < ncpus; ++j) printf(" %6d", cpus[j]);
+        printf("\n");
+        for (int i = 0; i < ncpus; ++i) {
+            printf("%4d ", cpus[i]);
+            for (int j = 0; j < ncpus; ++j) {
+                if (i == j) printf(" %6s", "-");
+                else printf(" %6.1f", ns[m][i][j]);
+            }
+            printf("\n");
+        }
+    }
+
+    printf("\nby placement          %-20s %-20s %-20s\n%-20s", method_name[M_CAS], method_name[M_FLAG],
+           method_name[M_FAA], "");
+    for (int m = 0; m < NMETHOD; ++m) printf(" %6s %6s %6s ", "min", "mean", "max");
+    printf("\n");
+    for (int rel = REL_SELF; rel < NREL; ++rel) {
+        double lo[NMETHOD], sum[NMETHOD] = { 0 }, hi[NMETHOD] = { 0 };
+        int n = 0;
+        for (int m = 0; m < NMETHOD; ++m) lo[m] = 1e300;
+        for (int i = 0; i < ncpus; ++i)
+            for (int j = 0; j < ncpus; ++j) {
+                if (i == j || topo_relation(&topo[i], &topo[j]) != (enum topo_rel)rel) continue;
+                for (int m = 0; m < NMETHOD; ++m) {
+                    double x = ns[m][i][j];
+                    if (x < lo[m]) lo[m] = x;
+                    if (x > hi[m]) hi[m] = x;
+                    sum[m] += x;
+                }
+                ++n;
+            }
+        if (!n) continue;
+        printf("%-10s %4d pairs ", topo_rel_name[rel], all ? n : n / 2);
+        for (int m = 0; m < NMETHOD; ++m) printf(" %6.1f %6.1f %6.1f ", lo[m], sum[m] / n, hi[m]);
+        printf("\n");
+    }
+    printf("wrote %s\n", out_path);
+
+    fclose(out);
+    free(line);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-c cpu_list] [-r rounds] [-a] [-o c2c.csv]\n", av[0]);
+    return 1;
+}
@@ -0,0 +1,58 @@
+// chase.h -- random pointer chains for the latency-style benchmarks.
+//
+// A chain is a single random cycle (Sattolo's algorithm) over n nodes that
+// sit `stride` bytes apart; each node holds the address of the next, so
+// walking it is a sequence of dependent loads the prefetchers cannot
+// predict. latency.c and numa_matrix.c walk one chain (chase_ns), mlp.c
+// several at once.
+#ifndef CHASE_H
+#define CHASE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "timer.h"      // now_sec
+
+__attribute__((unused)) static uint64_t chase_rng_state = 0x2545F4914F6CDD1DULL;
+
+static inline uint64_t chase_rng(void) {
+    chase_rng_state ^= chase_rng_state << 13;
+    chase_rng_state ^= chase_rng_state >> 7;
+    chase_rng_state ^= chase_rng_state << 17;
+    return chase_rng_state;
+}
+
+// Sattolo: a uniformly random permutation that is a single cycle.
+static inline void chase_cycle(uint32_t *perm, size_t n) {
+    for (size_t i = 0; i < n; ++i) perm[i] = (uint32_t)i;
+    for (size_t i = n - 1; i > 0; --i) {
+        size_t j = chase_rng() % i;
+        uint32_t t = perm[i]; perm[i] = perm[j]; perm[j] = t;
+    }
+}
+
+// Links n nodes at base + i*stride into one random cycle; returns its head.
+// `perm` is scratch space for n entries.
+static inline void **chase_link(char *base, size_t stride, size_t n, uint32_t *perm) {
+    chase_cycle(perm, n);
+    for (size_t i = 0; i < n; ++i)
+        *(void **)(base + i * stride) = base + (size_t)perm[i] * stride;
+    return (void **)base;
+}
+
+// Walks `loads` dependent loads from `start` (after a 1/16 warm-up walk);
+// returns ns per load.
+static inline double chase_ns(void **start, long loads) {
+    void **p = start;
+    for (long i = 0; i < loads / 16; ++i) p = (void **)*p;
+    double t0 = now_sec();
+    for (long i = 0; i < loads; i += 16) {
+#define HOP p = (void **)*p;
+        HOP HOP HOP HOP HOP HOP HOP HOP HOP HOP HOP HOP HOP HOP HOP HOP
+#undef HOP
+    }
+    double t1 = now_sec();
+    asm volatile("" :: "r"(p));
+    return (t1 - t0) * 1e9 / (double)loads;
+}
+
+#endif // CHASE_H
@@ -0,0 +1,164 @@
+// coldpool.h -- cold-cache samples without clflush.
+//
+// Instead of flushing src and dst before every copy (65,536 clflushes per
+// sample at 2 MiB), memtest() can rotate through a pool of src/dst pairs
+// whose combined footprint is COLD_FACTOR x the last-level cache. Pairs are
+// visited in a random order, so by the time a pair comes round again
+// everything else in the pool has pushed it out of the LLC; a 128 B guard
+// gap between slots keeps the adjacent-line prefetcher from warming the
+// next slot. cold_pool_verify() checks the claim: it times a single load
+// of pool lines just before they would be copied and counts how many
+// really came from DRAM (threshold calibrated from a hot and a flushed
+// line).
+#ifndef COLDPOOL_H
+#define COLDPOOL_H
+
+#include "bench.h"
+#include "arena.h"
+
+#define COLD_FACTOR    4                 // pool footprint / LLC size
+#define COLD_MAX_BYTES (4UL << 30)       // never map more than this
+#define COLD_GUARD     128               // gap between slots
+#define COLD_PROBES    512               // loads per verification pass
+
+// LLC size from sysfs (highest cache level), or 32 MiB if unknown.
+static inline size_t llc_bytes(void) {
+    size_t best = 0;
+    int best_level = 0;
+    for (int i = 0; i < 8; ++i) {
+        char path[128], buf[64];
+        int level = 0;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", i);
+        FILE *f = fopen(path, "r");
+        if (!f) break;
+        if (fscanf(f, "%d", &level) != 1) level = 0;
+        fclose(f);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+        if (!(f = fopen(path, "r"))) continue;
+        if (fgets(buf, sizeof(buf), f)) {
+            char *end;
+            size_t v = strtoul(buf, &end, 10);
+            if (*end == 'K') v <<= 10;
+            else if (*end == 'M') v <<= 20;
+            if (level >= best_level) { best_level = level; best = v; }
+        }
+        fclose(f);
+    }
+    return best ? best : (32UL << 20);
+}
+
+struct cold_pool {
+    struct arena ar;
+    size_t bytes, slot;         // copy size, distance between slots
+    size_t npairs, next;
+    uint32_t *order;            // random visiting order
+};
+
+static inline char *cold_src(const struct cold_pool *p, size_t i) {
+    return p->ar.base + (2 * i) * p->slot;
+}
+
+static inline char *cold_dst(const struct cold_pool *p, size_t i) {
+    return p->ar.base + (2 * i + 1) * p->slot;
+}
+
+// Sets up enough pairs of `bytes` to cover COLD_FACTOR x `llc` on `kind`
+// pages; THP or larger keeps the extra page walks of a huge pool small.
+// Returns 0 on success.
+static inline int cold_pool_init(struct cold_pool *p, size_t bytes, size_t llc,
+                                 enum arena_backing kind) {
+    memset(p, 0, sizeof(*p));
+    p->bytes = bytes;
+    p->slot = ((bytes + CACHELINE - 1) & ~(size_t)(CACHELINE - 1)) + COLD_GUARD;
+    size_t want = COLD_FACTOR * llc;
+    if (want > COLD_MAX_BYTES) want = COLD_MAX_BYTES;
+    p->npairs = want / (2 * p->slot);
+    if (p->npairs < 2) p->npairs = 2;
+    if (arena_alloc(&p->ar, 2 * p->npairs * p->slot, kind)) return -1;
+    memset(p->ar.base, 0xA5, p->ar.bytes);
+
+    p->order = (uint32_t *)malloc(p->npairs * sizeof(uint32_t));
+    if (!p->order) { perror("malloc"); exit(1); }
+    for (size_t i = 0; i < p->npairs; ++i) p->order[i] = (uint32_t)i;
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = p->npairs - 1; i > 0; --i) {       // Fisher-Yates
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        size_t j = x % (i + 1);
+        uint32_t t = p->order[i]; p->order[i] = p->order[j]; p->order[j] = t;
+    }
+    return 0;
+}
+
+static inline void cold_pool_free(struct cold_pool *p) {
+    arena_free(&p->ar);
+    free(p->order);
+    p->order = NULL;
+}
+
+// Next pair in the rotation.
+static inline void cold_pool_next(struct cold_pool *p, char **src, char **dst) {
+    size_t i = p->order[p->next];
+    if (++p->next == p->npairs) p->next = 0;
+    *src = cold_src(p, i);
+    *dst = cold_dst(p, i);
+}
+
+static inline uint64_t probe_load(const char *a) {
+    uint64_t t0 = tsc_begin();
+    (void)*(volatile const char *)a;
+    uint64_t t1 = tsc_end();
+    return t1 - t0;
+}
+
+// Median load latency of a cached line and of a flushed line.
+static inline void cold_calibrate(char *line, uint64_t *hit, uint64_t *miss) {
+    uint64_t h[101], m[101];
+    for (int i = 0; i < 101; ++i) {
+        (void)*(volatile char *)line;
+        h[i] = probe_load(line);
+        clflush_range(line, 1);
+        m[i] = probe_load(line);
+    }
+    qsort(h, 101, sizeof(uint64_t), cmp_u64);
+    qsort(m, 101, sizeof(uint64_t), cmp_u64);
+    *hit = h[50];
+    *miss = m[50];
+}
+
+// Runs the rotation the way memtest() does (copying with `fn`) and, for
+// COLD_PROBES pairs, times one load of src and dst right before the copy.
+// Reports the fraction of probes slower than the hit/miss midpoint.
+static inline double cold_pool_verify(struct cold_pool *p,
+                                      void (*fn)(void *, const void *, size_t),
+                                      int print) {
+    uint64_t hit, miss;
+    cold_calibrate(cold_src(p, 0), &hit, &miss);
+    uint64_t thr = (hit + miss) / 2;
+
+    for (size_t i = 0; i < p->npairs; ++i) {           // one full lap first
+        char *s, *d;
+        cold_pool_next(p, &s, &d);
+        fn(d, s, p->bytes);
+    }
+    size_t every = p->npairs / COLD_PROBES + 1, probes = 0, missed = 0;
+    for (size_t i = 0; probes < COLD_PROBES && i < 4 * p->npairs; ++i) {
+        char *s, *d;
+        cold_pool_next(p, &s, &d);
+        if (i % every == 0) {
+            // probe a line in the middle so the head of the copy stays honest
+            size_t off = (p->bytes / 2) & ~(size_t)(CACHELINE - 1);
+            missed += probe_load(s + off) > thr;
+            missed += probe_load(d + off) > thr;
+            probes += 2;
+        }
+        fn(d, s, p->bytes);
+    }
+    double rate = probes ? (double)missed / (double)probes : 0;
+    if (print)
+        printf("  cold pool: %zu pairs, %zu MiB; load hit=%" PRIu64 " miss=%" PRIu64
+               " ticks; %.1f%% of %zu probes missed\n", p->npairs, p->ar.bytes >> 20,
+               hit, miss, 100 * rate, probes);
+    return rate;
+}
+
+#endif // COLDPOOL_H
@@ -0,0 +1,250 @@
+// color.h -- page-colored buffers carved out of an arena.
+//
+// Two buffers from separate posix_memalign() calls land on whatever frames
+// the kernel hands out, so from run to run src[i] and dst[i] may or may not
+// share L2 sets or a DRAM bank, and a copy between them picks up that
+// variance. A color pool is one big arena (arena.h) cut into 4 KiB frames,
+// each tagged with two colors of its physical address:
+//   cache  PA bits 12 .. log2(L2 sets x 64) - 1: frames of one cache color
+//          share the same L2 sets (and, on Intel, the same sets in every
+//          LLC slice, whose hash only picks the slice)
+//   bank   the bank functions of dram_map.txt (bankmap.c) with the in-page
+//          bits dropped: at equal offsets, lines of two frames of one bank
+//          color sit in the same bank
+// color_alloc() assembles a virtually contiguous buffer from frames of one
+// chosen color, or spread over all colors, by mremap()ing the frames next to
+// each other; color_alloc_like() builds a second buffer whose page i has
+// the same color as page i of the first (aliased) or differs from it in both
+// cache and bank color (distinct). color_free() moves the frames back.
+//
+// The pool is 4k or THP: mremap() cannot move a 4 KiB piece of a hugetlbfs
+// page, so 2M / 1G pools are refused. Without visible PFNs (not root) only
+// the offset inside a backing page is known: a THP pool still gives cache
+// colors, bank colors only for functions below 2 MiB. Colored buffers are
+// always mapped with 4 KiB pages.
+#ifndef COLOR_H
+#define COLOR_H
+
+#include "arena.h"
+#include "dram_map.h"
+#include "topo.h"
+
+#define COLOR_MAX_CACHE 256
+#define COLOR_ANY       (-1)
+
+struct color_pool {
+    struct arena ar;
+    int      ncache;                // cache colors (power of two)
+    int      nbank;                 // bank colors (1 << nmask)
+    int      nmask;
+    uint64_t mask[DRAM_MAX_FUNCS];  // page-level bank functions
+    int      ncolors;               // ncache * nbank; color = bank * ncache + cache
+    uint16_t *fcolor;               // color of each frame
+    uint32_t *page;                 // frame indices grouped by color
+    size_t   *start, *avail;        // per color: first slot in page[], frames left
+    size_t   spread;                // round-robin cursor for COLOR_ANY
+};
+
+struct color_buf {
+    char     *base;
+    size_t    bytes, npages;
+    uint32_t *frame;                // pool frame index of each page
+};
+
+// L2 sets x line / 4 KiB, from sysfs; 1 if the kernel does not say.
+static inline int color_cache_colors(void) {
+    char path[160];
+    for (int i = 0; i < 8; ++i) {
+        snprintf(path, sizeof(path), TOPO_SYSFS "/cpu0/cache/index%d/level", i);
+        int level = topo_read_first(path, -1);
+        if (level < 0) break;
+        if (level != 2) continue;
+        snprintf(path, sizeof(path), TOPO_SYSFS "/cpu0/cache/index%d/number_of_sets", i);
+        long span = (long)topo_read_first(path, 0) * 64;
+        int n = 1;
+        while (n < COLOR_MAX_CACHE && (long)n * 2 * (long)ARENA_SMALL <= span) n *= 2;
+        return n;
+    }
+    return 1;
+}
+
+static inline uint64_t color_frame_pa(const struct color_pool *p, size_t idx) {
+    const char *va = p->ar.base + idx * ARENA_SMALL;
+    if (arena_has_pa(&p->ar)) return arena_pa(&p->ar, va);
+    return (uint64_t)(idx * ARENA_SMALL) & (p->ar.page - 1);    // offset in the backing page
+}
+
+static inline int color_of_pa(const struct color_pool *p, uint64_t pa) {
+    int bank = 0;
+    for (int i = 0; i < p->nmask; ++i) bank |= __builtin_parityll(pa & p->mask[i]) << i;
+    return bank * p->ncache + (int)((pa / ARENA_SMALL) & (uint64_t)(p->ncache - 1));
+}
+
+static inline int color_cache(const struct color_pool *p, int c) { return c % p->ncache; }
+static inline int color_bank(const struct color_pool *p, int c) { return c / p->ncache; }
+
+// Maps a `bytes` pool of `kind` (4k or thp) pages and sorts its frames by
+// color. `map` may be NULL (cache colors only). Returns 0 on success.
+static inline int color_pool_init(struct color_pool *p, size_t bytes, enum arena_backing kind,
+                                  const struct dram_map *map) {
+    memset(p, 0, sizeof(*p));
+    if (kind == ARENA_2M || kind == ARENA_1G) {
+        fprintf(stderr, "color pool: %s pages cannot be split into 4 KiB frames, use 4k or thp\n",
+                arena_backing_name[kind]);
+        return -1;
+    }
+    if (arena_alloc(&p->ar, bytes, kind)) return -1;
+    int pa = arena_has_pa(&p->ar);
+    uint64_t known = pa ? ~0ULL : p->ar.page - 1;
+    p->ncache = color_cache_colors();
+    while (!pa && (uint64_t)p->ncache * ARENA_SMALL > p->ar.page) p->ncache /= 2;
+    for (int i = 0; map && i < map->nfuncs && p->nmask < 8; ++i) {
+        uint64_t m = map->masks[i] & ~(ARENA_SMALL - 1);
+        if (m && !(m & ~known)) p->mask[p->nmask++] = m;
+    }
+    p->nbank = 1 << p->nmask;
+    p->ncolors = p->ncache * p->nbank;
+
+    size_t n = p->ar.bytes / ARENA_SMALL;
+    p->fcolor = (uint16_t *)malloc(n * sizeof(uint16_t));
+    p->page = (uint32_t *)malloc(n * sizeof(uint32_t));
+    p->start = (size_t *)calloc((size_t)p->ncolors, sizeof(size_t));
+    p->avail = (size_t *)calloc((size_t)p->ncolors, sizeof(size_t));
+    if (!p->fcolor || !p->page || !p->start || !p->avail) { perror("malloc"); return -1; }
+    for (size_t i = 0; i < n; ++i) ++p->avail[p->fcolor[i] = (uint16_t)color_of_pa(p, color_frame_pa(p, i))];
+    for (int c = 1; c < p->ncolors; ++c) p->start[c] = p->start[c - 1] + p->avail[c - 1];
+    memset(p->avail, 0, (size_t)p->ncolors * sizeof(size_t));
+    for (size_t i = 0; i < n; ++i) p->page[p->start[p->fcolor[i]] + p->avail[p->fcolor[i]]++] = (uint32_t)i;
+    return 0;
+}
+
+static inline void color_pool_free(struct color_pool *p) {
+    arena_free(&p->ar);
+    free(p->fcolor);
+    free(p->page);
+    free(p->start);
+    free(p->avail);
+    memset(p, 0, sizeof(*p));
+}
+
+// Color of the frame behind `va`, which must point into a color_buf.
+static inline int color_of(const struct color_pool *p, const struct color_buf *b, const char *va) {
+    return p->fcolor[b->frame[(size_t)(va - b->base) / ARENA_SMALL]];
+}
+
+static inline int color_take(struct color_pool *p, int c, uint32_t *frame) {
+    if (!p->avail[c]) return -1;
+    *frame = p->page[p->start[c] + --p->avail[c]];
+    return 0;
+}
+
+static inline void color_give(struct color_pool *p, uint32_t frame) {
+    int c = p->fcolor[frame];
+    p->page[p->start[c] + p->avail[c]++] = frame;
+}
+
+// Drops the buffer's address range and gives back frames [0, ntaken),
+// which were taken from the pool but never moved. Returns -1.
+static inline int color_unreserve(struct color_pool *p, struct color_buf *b, size_t ntaken) {
+    for (size_t i = 0; i < ntaken; ++i) color_give(p, b->frame[i]);
+    if (b->base) munmap(b->base, b->bytes);
+    free(b->frame);
+    memset(b, 0, sizeof(*b));
+    return -1;
+}
+
+// Reserves the buffer's address range; color_map() moves the frames in.
+static inline int color_reserve(struct color_buf *b, size_t bytes) {
+    b->npages = (bytes + ARENA_SMALL - 1) / ARENA_SMALL;
+    b->bytes = b->npages * ARENA_SMALL;
+    b->frame = (uint32_t *)malloc(b->npages * sizeof(uint32_t));
+    b->base = (char *)mmap(NULL, b->bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (b->base == MAP_FAILED) b->base = NULL;
+    if (!b->frame || !b->base) { perror("color buffer"); return color_unreserve(NULL, b, 0); }
+    return 0;
+}
+
+// Moves the frames back into the pool, over their placeholders.
+static inline void color_free(struct color_pool *p, struct color_buf *b) {
+    for (size_t i = 0; i < b->npages; ++i) {
+        char *to = p->ar.base + (size_t)b->frame[i] * ARENA_SMALL;
+        if (mremap(b->base + i * ARENA_SMALL, ARENA_SMALL, ARENA_SMALL,
+                   MREMAP_MAYMOVE | MREMAP_FIXED, to) == MAP_FAILED) {
+            perror("mremap");       // the frame stays out of the pool
+            continue;
+        }
+        color_give(p, b->frame[i]);
+    }
+    color_unreserve(p, b, 0);
+}
+
+// Moves the frames listed in b->frame to consecutive pages of b->base. The
+// slot a frame leaves gets a PROT_NONE placeholder, or the next mmap() could
+// land in the pool and be overwritten when the frame comes back.
+static inline int color_map(struct color_pool *p, struct color_buf *b) {
+    for (size_t i = 0; i < b->npages; ++i) {
+        char *from = p->ar.base + (size_t)b->frame[i] * ARENA_SMALL;
+        if (mremap(from, ARENA_SMALL, ARENA_SMALL, MREMAP_MAYMOVE | MREMAP_FIXED,
+                   b->base + i * ARENA_SMALL) == MAP_FAILED) {
+            perror("mremap");
+            for (size_t j = i; j < b->npages; ++j) color_give(p, b->frame[j]);
+            b->npages = i;          // move back the ones already here
+            color_free(p, b);
+            return -1;
+        }
+        if (mmap(from, ARENA_SMALL, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE,
+                 -1, 0) == MAP_FAILED)
+            perror("mmap placeholder");
+    }
+    return 0;
+}
+
+// A `bytes` buffer of frames of cache color `cache` and bank color `bank`;
+// COLOR_ANY for either spreads the pages round-robin over that dimension.
+// Returns -1 if the pool has too few frames of a color.
+static inline int color_alloc(struct color_pool *p, struct color_buf *b, size_t bytes,
+                              int cache, int bank) {
+    if (color_reserve(b, bytes)) return -1;
+    for (size_t i = 0; i < b->npages; ++i) {
+        int got = -1;
+        for (int k = 0; k < p->ncolors && got; ++k, ++p->spread) {
+            int cc = cache == COLOR_ANY ? (int)(p->spread % (size_t)p->ncache) : cache;
+            int bc = bank == COLOR_ANY ? (int)(p->spread / (size_t)p->ncache % (size_t)p->nbank) : bank;
+            got = color_take(p, bc * p->ncache + cc, &b->frame[i]);
+            if (cache != COLOR_ANY && bank != COLOR_ANY) break;
+        }
+        if (got) {
+            fprintf(stderr, "color pool: out of frames of color (%d, %d)\n", cache, bank);
+            return color_unreserve(p, b, i);
+        }
+    }
+    return color_map(p, b);
+}
+
+// A buffer as large as `ref` whose page i has the color of ref's page i
+// (aliased) or a different cache and, where there are any, bank color.
+static inline int color_alloc_like(struct color_pool *p, struct color_buf *b,
+                                   const struct color_buf *ref, int aliased) {
+    if (color_reserve(b, ref->bytes)) return -1;
+    for (size_t i = 0; i < b->npages; ++i) {
+        int c = color_of(p, ref, ref->base + i * ARENA_SMALL), got = -1;
+        if (aliased) {
+            got = color_take(p, c, &b->frame[i]);
+        } else {                    // farthest cache color first, any other bank
+            int cc = color_cache(p, c), bc = color_bank(p, c);
+            for (int k = 0; k < p->ncolors && got; ++k) {
+                int dc = (cc + p->ncache / 2 + k % p->ncache) % p->ncache;
+                int db = bc ^ (p->nbank - 1) ^ (k / p->ncache);
+                if ((p->ncache > 1 && dc == cc) || (p->nbank > 1 && db == bc)) continue;
+                got = color_take(p, db * p->ncache + dc, &b->frame[i]);
+            }
+        }
+        if (got) {
+            fprintf(stderr, "color pool: no %s frame for page %zu\n", aliased ? "aliased" : "distinct", i);
+            return color_unreserve(p, b, i);
+        }
+    }
+    return color_map(p, b);
+}
+
+#endif // COLOR_H
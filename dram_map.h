@@ -0,0 +1,81 @@
+// dram_map.h -- a recovered physical-address -> DRAM mapping.
+//
+// Written by bankmap.c, read by anything that wants to place data by bank.
+// Bank/rank/channel selection is modelled as a set of XOR functions: bit i
+// of the bank index is the parity of (pa & masks[i]). Timing alone cannot
+// tell a channel or rank bit from a bank bit, so they are all in `masks`.
+//
+// File format (dram_map.txt), one "key value..." per line, '#' comments:
+//   funcs 0x2040 0x44000 ...
+//   row_bits 18 33
+//   col_bits 6 12
+//   threshold 410
+#ifndef DRAM_MAP_H
+#define DRAM_MAP_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define DRAM_MAX_FUNCS 16
+#define DRAM_MAP_FILE  "dram_map.txt"
+
+struct dram_map {
+    int      nfuncs;
+    uint64_t masks[DRAM_MAX_FUNCS];
+    int      row_lo, row_hi;        // inclusive bit range, -1 if unknown
+    int      col_lo, col_hi;
+    uint64_t threshold;             // A->B->A ticks separating conflict from not
+};
+
+static inline unsigned dram_bank(const struct dram_map *m, uint64_t pa) {
+    unsigned b = 0;
+    for (int i = 0; i < m->nfuncs; ++i)
+        b |= (unsigned)__builtin_parityll(pa & m->masks[i]) << i;
+    return b;
+}
+
+static inline uint64_t dram_row(const struct dram_map *m, uint64_t pa) {
+    if (m->row_lo < 0) return 0;
+    return (pa >> m->row_lo) & ((1ULL << (m->row_hi - m->row_lo + 1)) - 1);
+}
+
+static inline int dram_map_save(const struct dram_map *m, const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) { perror(path); return -1; }
+    fprintf(f, "# recovered by bankmap\nfuncs");
+    for (int i = 0; i < m->nfuncs; ++i) fprintf(f, " 0x%" PRIx64, m->masks[i]);
+    fprintf(f, "\nrow_bits %d %d\ncol_bits %d %d\nthreshold %" PRIu64 "\n",
+            m->row_lo, m->row_hi, m->col_lo, m->col_hi, m->threshold);
+    fclose(f);
+    return 0;
+}
+
+static inline int dram_map_load(struct dram_map *m, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    memset(m, 0, sizeof(*m));
+    m->row_lo = m->row_hi = m->col_lo = m->col_hi = -1;
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        if (!strncmp(line, "funcs", 5)) {
+            char *p = line + 5, *end;
+            while (m->nfuncs < DRAM_MAX_FUNCS) {
+                uint64_t v = strtoull(p, &end, 0);
+                if (end == p) break;
+                m->masks[m->nfuncs++] = v;
+                p = end;
+            }
+        } else {
+            sscanf(line, "row_bits %d %d", &m->row_lo, &m->row_hi);
+            sscanf(line, "col_bits %d %d", &m->col_lo, &m->col_hi);
+            sscanf(line, "threshold %" SCNu64, &m->threshold);
+        }
+    }
+    fclose(f);
+    return m->nfuncs ? 0 : -1;
+}
+
+#endif // DRAM_MAP_H
@@ -0,0 +1,139 @@
+// evset.c -- LLC geometry by timing, and eviction without clflush.
+//
+// Builds minimal eviction sets (evset.h) in a -M MiB arena of huge pages
+// and reports:
+//   - the hit / LLC-hit / DRAM latencies and the threshold between them;
+//   - the associativity (eviction set size), the set-index stride, sets
+//     per slice and the slice count, next to what CPUID reports via sysfs;
+//   - with PFNs visible (root), the slice hash as XOR masks of PA bits;
+//   - for LLC set -s in slice class -l: the latency of a victim after
+//     walking its eviction set, next to hot and clflush'ed, i.e. how well
+//     the set replaces clflush;
+//   - a conflict sweep: a pointer chase through k lines of that one set,
+//     k = 1 .. 2 x ways. The knees are where k passes the L1, L2 and LLC
+//     associativity (all k lines share the L1 and L2 set too) -- the curve
+//     a data structure with a power-of-two stride lands on. -o writes it.
+//
+// Eviction sets on a non-inclusive LLC (Skylake-SP and later server parts)
+// also have to push the victim out of L2, which the walk does; results on
+// VMs depend on how the host backs the guest's memory.
+//
+// usage: ./evset [-M MiB] [-p thp|2m|1g] [-c cpu] [-s set] [-l slice] [-o evset.csv]
+#define _GNU_SOURCE
+#include <unistd.h>
+#include "bench.h"
+#include "evset.h"
+#include "topo.h"
+
+#define SAMPLES   101
+#define SWEEP_MAX (2 * EVSET_MAX_WAYS)
+
+static uint64_t median_after(char *victim, char *const *set, int n, int flush) {
+    uint64_t t[SAMPLES];
+    for (int i = 0; i < SAMPLES; ++i) {
+        (void)*(volatile char *)victim;
+        _mm_mfence();
+        if (flush) clflush_range(victim, 1);
+        else evset_walk(set, (size_t)n);
+        t[i] = probe_load(victim);
+    }
+    qsort(t, SAMPLES, sizeof(uint64_t), cmp_u64);
+    return t[SAMPLES / 2];
+}
+
+int main(int ac, char **av) {
+    size_t mb = 0, set = 0;
+    int slice = 0, cpu = -1, opt;
+    enum arena_backing backing = ARENA_THP;
+    const char *out_path = "evset.csv";
+    while ((opt = getopt(ac, av, "M:p:c:s:l:o:")) != -1) {
+        switch (opt) {
+        case 'M': mb = (size_t)atol(optarg); break;
+        case 'p': if (arena_parse_backing(optarg, &backing) || backing == ARENA_4K) goto usage; break;
+        case 'c': cpu = atoi(optarg); break;
+        case 's': set = (size_t)atol(optarg); break;
+        case 'l': slice = atoi(optarg); break;
+        case 'o': out_path = optarg; break;
+        default:  goto usage;
+        }
+    }
+    if (!mb) {                              // twice the LLC, within reason
+        mb = 2 * llc_bytes() >> 20;
+        if (mb < 64) mb = 64;
+        if (mb > 2048) mb = 2048;
+    }
+    if (cpu < 0 && allowed_cpus(&cpu, 1) < 1) cpu = 0;
+    if (pin_cpu(cpu)) { fprintf(stderr, "cannot pin to cpu %d\n", cpu); return 1; }
+    timer_init(1);
+
+    static struct evset e;
+    if (evset_init(&e, mb << 20, backing)) return 1;
+    printf("cpu %d, %zu MiB of %s pages, PFNs %s\n", cpu, e.ar.bytes >> 20, arena_backing_name[e.ar.kind],
+           arena_has_pa(&e.ar) ? "visible" : "hidden (in-page bits only)");
+    printf("load latency: hit %" PRIu64 ", LLC hit %" PRIu64 ", DRAM %" PRIu64 " ticks -> evicted above %" PRIu64 "\n",
+           e.hit, e.llc_hit, e.miss, e.thr);
+    if (e.llc_hit * 4 > e.miss * 3)
+        fprintf(stderr, "warning: LLC hits and DRAM misses barely differ, expect noise\n");
+
+    double t0 = now_sec();
+    if (evset_discover(&e, 1)) {
+        fprintf(stderr, "no minimal eviction set: either the pool is too small for this LLC (-M), or\n"
+                        "the victim is evicted by the volume of the walk rather than by set conflicts\n"
+                        "(an LLC shared with other VMs, partitioned, or with randomized indexing)\n");
+        return 1;
+    }
+    struct cpu_topo topo;
+    topo_get(cpu, &topo);
+    printf("discovery took %.1f s\n", now_sec() - t0);
+    printf("  ways           %d (CPUID %d)\n", e.ways, topo.llc_ways);
+    printf("  set stride     %zu B -> %zu sets per slice\n", e.stride, e.sets);
+    printf("  slices         %d congruence classes at set 0 (LLC / (ways x stride) = %.1f)\n", e.slices,
+           (double)llc_bytes() / ((double)e.ways * (double)e.stride));
+    printf("  total sets     %zu (CPUID %d)\n", e.sets * (size_t)e.slices, topo.llc_sets);
+    if (e.nhash) {
+        printf("  slice hash     bit i of the slice = parity(PA & mask_i) over bits >= %d:\n",
+               __builtin_ctzll(e.stride));
+        for (int i = 0; i < e.nhash; ++i) printf("    mask_%d 0x%012" PRIx64 "\n", i, e.hash[i]);
+    } else if (arena_has_pa(&e.ar)) {
+        printf("  slice hash     not linear over the sampled bits (or too few lines), classes by timing\n");
+    }
+
+    char *lines[SWEEP_MAX + 1];
+    if (set >= e.sets || slice >= e.slices) {
+        fprintf(stderr, "-s must be < %zu and -l < %d\n", e.sets, e.slices);
+        return 1;
+    }
+    int want = 2 * e.ways + 1 <= SWEEP_MAX + 1 ? 2 * e.ways + 1 : SWEEP_MAX + 1;
+    int got = evset_get(&e, set, slice, lines, want);
+    printf("\nset %zu, slice class %d: %d lines\n", set, slice, got);
+    if (got <= e.ways) { fprintf(stderr, "not enough congruent lines in the arena (try -M)\n"); return 1; }
+
+    char *victim = lines[0];
+    uint64_t hot = median_after(victim, NULL, 0, 0);
+    uint64_t ev = median_after(victim, lines + 1, e.ways, 0);
+    uint64_t ev1 = median_after(victim, lines + 1, e.ways - 1, 0);
+    uint64_t fl = median_after(victim, NULL, 0, 1);
+    printf("victim after: nothing %.1f ns, %d congruent lines %.1f ns, %d lines %.1f ns, clflush %.1f ns\n",
+           ticks_ns((double)hot), e.ways, ticks_ns((double)ev), e.ways - 1, ticks_ns((double)ev1),
+           ticks_ns((double)fl));
+
+    FILE *out = fopen(out_path, "w");
+    if (!out) { perror(out_path); return 1; }
+    fprintf(out, "Lines,NsPerLoad\n");
+    printf("\nconflict sweep: chase through k lines of one set\n%6s %10s\n", "k", "ns/load");
+    for (int k = 1; k < got; ++k) {
+        for (int i = 0; i < k; ++i) *(void **)lines[i] = lines[(i + 1) % k];
+        double ns = chase_ns((void **)lines[0], 1L << 18);
+        printf("%6d %10.2f%s\n", k, ns, k == e.ways ? "   <- LLC ways" : "");
+        fprintf(out, "%d,%.3f\n", k, ns);
+    }
+    printf("wrote %s\n", out_path);
+
+    fclose(out);
+    evset_free(&e);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-M MiB] [-p thp|2m|1g] [-c cpu] [-s set] [-l slice] [-o evset.csv]\n", av[0]);
+    return 1;
+}
@@ -0,0 +1,327 @@
+// evset.h -- LLC eviction sets built by timing; set, way and slice discovery.
+//
+// clflush makes a line cold but says nothing about how the LLC is laid
+// out. An eviction set for a victim line is a set of lines that map to the
+// same LLC set *and* slice; walking it pushes the victim out without
+// clflush. We find them by timing alone, with coldpool.h's probe_load():
+//
+//   threshold  a victim touched and then left alone for an L2-sized sweep
+//              is an LLC hit, a flushed one a DRAM miss; thr is between them
+//   evicts     touch victim, walk the candidates EVSET_PASSES times, time
+//              the victim: slower than thr = evicted (majority of votes)
+//   reduce     group testing (Vila et al.): split the set in ways+1 groups,
+//              drop any group without which it still evicts; with more
+//              groups than ways one always goes. The last rounds drop
+//              single lines, so the result is minimal: its size is the
+//              associativity
+//
+// evset_discover() then finds the geometry. The first eviction set comes
+// from lines at the victim's offset in every 4 KiB page. All of its lines
+// agree in the set-index bits, so the lowest physical bit >= 12 where they
+// differ is the set-index period (stride = sets per slice x 64). That
+// needs physically contiguous pages (THP / 2M / 1G arena), or PFNs from
+// pagemap. Lines one stride apart then differ only in the slice: sorting
+// them into congruence classes counts the slices. With PFNs visible, the
+// classes also give the slice hash. Each hash bit is the parity of PA &
+// mask, and the masks are the vectors orthogonal to every within-class
+// address difference.
+//
+// evset_get(set, slice) returns lines that all map to one set of one
+// slice. With the hash known, a slice id is its hash value and no timing
+// is needed. Otherwise discovery numbers the set-0 classes in address order
+// of first appearance and keeps each one's first line as its anchor; at
+// another set, class k is the one holding the line at anchor k's index.
+// Either way ids are stable across calls. The hash (and so the anchoring)
+// only covers bits >= stride: if the real hash also uses set-index bits,
+// one id may name different physical slices at different sets, a constant
+// relabelling per set. evset_walk() evicts with the lines.
+#ifndef EVSET_H
+#define EVSET_H
+
+#include "bench.h"
+#include "arena.h"
+#include "chase.h"
+#include "coldpool.h"
+
+#define EVSET_MAX_WAYS   32          // reduction uses MAX_WAYS + 1 groups
+#define EVSET_VOTES      5           // for small sets; big ones are timed once
+#define EVSET_PASSES     3
+#define EVSET_INIT       512         // first candidate count, doubled until it evicts
+#define EVSET_RETRIES    5
+#define EVSET_MAX_SLICES 128
+#define EVSET_CLASS_LINES 4096       // pool lines examined per set when classifying
+#define EVSET_MAX_HASH   8
+#define EVSET_SWEEP      (4UL << 20)  // L2-evicting sweep for the LLC-hit latency
+
+struct evset {
+    struct arena ar;
+    uint64_t hit, llc_hit, miss, thr;   // median ticks
+    int ways;                           // 0 until discovered
+    size_t stride;                      // set-index period, bytes
+    size_t sets;                        // per slice
+    int slices;
+    size_t anchor[EVSET_MAX_SLICES];    // set-0 line index of each class (timing path)
+    int nhash;                          // slice hash masks, if PFNs are visible
+    uint64_t hash[EVSET_MAX_HASH];
+    char **tmp;                         // scratch, one entry per 4 KiB of arena
+};
+
+// Touches every line of s `EVSET_PASSES` times: evicts whatever they conflict with.
+static inline void evset_walk(char *const *s, size_t n) {
+    for (int p = 0; p < EVSET_PASSES; ++p)
+        for (size_t i = 0; i < n; ++i) (void)*(volatile char *)s[i];
+}
+
+// 1 if walking s evicts `victim` from the LLC.
+static inline int evset_evicts(const struct evset *e, char *victim, char *const *s, size_t n) {
+    int votes = n > 4 * EVSET_MAX_WAYS ? 1 : EVSET_VOTES, yes = 0;
+    for (int v = 0; v < votes; ++v) {
+        (void)*(volatile char *)victim;
+        _mm_mfence();
+        evset_walk(s, n);
+        yes += probe_load(victim) > e->thr;
+    }
+    return 2 * yes > votes;
+}
+
+// Reduces s[0..n) (which must evict `victim`) to a minimal eviction set in
+// place; returns its size, or -1 if noise broke the reduction.
+static inline int evset_reduce(struct evset *e, char *victim, char **s, size_t n) {
+    char **rest = e->tmp;
+    while (n > 1) {
+        size_t g = n > EVSET_MAX_WAYS ? EVSET_MAX_WAYS + 1 : n;
+        int removed = 0;
+        for (size_t gi = 0; gi < g && !removed; ++gi) {
+            size_t lo = gi * n / g, hi = (gi + 1) * n / g, k = 0;
+            for (size_t i = 0; i < n; ++i) if (i < lo || i >= hi) rest[k++] = s[i];
+            if (evset_evicts(e, victim, rest, k)) {
+                memcpy(s, rest, k * sizeof(char *));
+                n = k;
+                removed = 1;
+            }
+        }
+        if (!removed) break;
+    }
+    if (n > EVSET_MAX_WAYS || !evset_evicts(e, victim, s, n)) return -1;
+    return (int)n;
+}
+
+// Minimal eviction set for `victim` from the lines `stride` bytes apart
+// from it (its own line excluded) into out[0..EVSET_MAX_WAYS). Returns the
+// size or -1.
+static inline int evset_build(struct evset *e, char *victim, size_t stride, char **out) {
+    size_t off = (size_t)(victim - e->ar.base) % stride, npool = 0;
+    size_t cap = e->ar.bytes / PAGE;
+    char **pool = (char **)xalloc(CACHELINE, cap * sizeof(char *));
+    for (size_t o = off; o < e->ar.bytes && npool < cap; o += stride)
+        if (e->ar.base + o != victim) pool[npool++] = e->ar.base + o;
+    int got = -1;
+    for (int r = 0; r < EVSET_RETRIES && got < 0; ++r) {
+        for (size_t i = npool - 1; i > 0; --i) {            // fresh random order each try
+            size_t j = chase_rng() % (i + 1);
+            char *t = pool[i]; pool[i] = pool[j]; pool[j] = t;
+        }
+        size_t n = npool < EVSET_INIT ? npool : EVSET_INIT;
+        while (!evset_evicts(e, victim, pool, n) && n < npool) n = 2 * n < npool ? 2 * n : npool;
+        if (!evset_evicts(e, victim, pool, n)) break;     // the whole pool does not evict
+        got = evset_reduce(e, victim, pool, n);
+    }
+    if (got > 0) memcpy(out, pool, (size_t)got * sizeof(char *));
+    free(pool);
+    return got;
+}
+
+// 1 if `y` maps to the same set and slice as the victim of minimal set s.
+static inline int evset_congruent(struct evset *e, char *victim, char *const *s, int n, char *y) {
+    char *t[EVSET_MAX_WAYS];
+    memcpy(t, s, (size_t)n * sizeof(char *));
+    t[0] = y;
+    return evset_evicts(e, victim, t, (size_t)n);
+}
+
+static inline int evset_cmp_int(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+static inline int evset_parity(uint64_t x) { return __builtin_parityll(x); }
+
+// Slice class value of physical address pa under the discovered hash.
+static inline unsigned evset_hash_value(const struct evset *e, uint64_t pa) {
+    unsigned v = 0;
+    for (int i = 0; i < e->nhash; ++i) v |= (unsigned)evset_parity(pa & e->hash[i]) << i;
+    return v;
+}
+
+// Sorts up to `max` lines at offset `off` (< stride), in address order,
+// into slice classes: cls[i] for line base + off + i*stride, -1 if it could
+// not be placed. With the hash known a class is its hash value. Otherwise
+// the first call (discovery, no classes yet) numbers classes by first
+// appearance and records their anchors; later calls build the eviction set
+// of the line at each anchor's index and number classes after it. Stops
+// early once class `want` (if >= 0) has `need` members. Returns the number
+// of classes.
+static inline int evset_classes(struct evset *e, size_t off, size_t max, int *cls, int want, int need) {
+    size_t n = (e->ar.bytes - off + e->stride - 1) / e->stride;
+    if (n > max) n = max;
+    if (e->nhash) {                     // no timing needed
+        int have = 0;
+        for (size_t i = 0; i < n; ++i) {
+            cls[i] = (int)evset_hash_value(e, arena_pa(&e->ar, e->ar.base + off + i * e->stride));
+            if (want >= 0 && cls[i] == want && ++have >= need) {
+                for (size_t j = i + 1; j < n; ++j) cls[j] = -1;
+                break;
+            }
+        }
+        return 1 << e->nhash;
+    }
+    static char *rep[EVSET_MAX_SLICES], *set[EVSET_MAX_SLICES][EVSET_MAX_WAYS];
+    static int size[EVSET_MAX_SLICES];
+    int nc = 0, have = 0, anchored = e->slices > 0;
+    for (size_t i = 0; i < n; ++i) cls[i] = -1;
+    if (anchored) {
+        for (nc = 0; nc < e->slices; ++nc) {
+            rep[nc] = e->anchor[nc] < n ? e->ar.base + off + e->anchor[nc] * e->stride : NULL;
+            size[nc] = rep[nc] ? evset_build(e, rep[nc], e->stride, set[nc]) : -1;
+        }
+    }
+    for (size_t i = 0; i < n; ++i) {
+        char *y = e->ar.base + off + i * e->stride;
+        for (int c = 0; c < nc && cls[i] < 0; ++c)
+            if (size[c] > 0 && (y == rep[c] || evset_congruent(e, rep[c], set[c], size[c], y))) cls[i] = c;
+        if (!anchored && cls[i] < 0 && nc < EVSET_MAX_SLICES &&
+            (size[nc] = evset_build(e, y, e->stride, set[nc])) > 0) {
+            rep[nc] = y;
+            e->anchor[nc] = i;
+            cls[i] = nc++;
+        }
+        if (want >= 0 && cls[i] == want && ++have >= need) break;
+    }
+    return nc;
+}
+
+// Fills out[0..n) with lines of LLC set `set` (0..sets-1) in slice class
+// `slice` (0..slices-1, see evset_classes). Returns how many were found
+// (fewer if the arena runs out or the class's anchor line would not build).
+static inline int evset_get(struct evset *e, size_t set, int slice, char **out, int n) {
+    if (!e->stride || set >= e->sets) return 0;
+    size_t off = set * CACHELINE, lines = e->ar.bytes / e->stride;
+    int *cls = (int *)xalloc(CACHELINE, lines * sizeof(int));
+    evset_classes(e, off, lines, cls, slice, n);
+    int got = 0;
+    for (size_t i = 0; i < lines && got < n; ++i)
+        if (cls[i] == slice) out[got++] = e->ar.base + off + i * e->stride;
+    free(cls);
+    return got;
+}
+
+// Slice hash from classified lines: masks orthogonal to all within-class
+// PA differences, over the bits >= stride that vary in the sample.
+static inline int evset_solve_hash(struct evset *e, size_t off, const int *cls, size_t n, int nclasses) {
+    uint64_t basis[64] = { 0 }, first[EVSET_MAX_SLICES] = { 0 }, vary = 0, pa0 = 0;
+    uint64_t lo_mask = ~(uint64_t)(e->stride - 1);
+    for (size_t i = 0; i < n; ++i) {
+        if (cls[i] < 0) continue;
+        uint64_t pa = arena_pa(&e->ar, e->ar.base + off + i * e->stride);
+        if (pa == ARENA_PA_NONE) return -1;
+        if (!pa0) pa0 = pa;
+        vary |= (pa ^ pa0) & lo_mask;
+        if (!first[cls[i]]) { first[cls[i]] = pa; continue; }
+        uint64_t d = (pa ^ first[cls[i]]) & lo_mask;        // insert into the xor basis
+        for (int b = 63; b >= 0 && d; --b) {
+            if (!(d >> b & 1)) continue;
+            if (!basis[b]) { basis[b] = d; d = 0; }
+            else d ^= basis[b];
+        }
+    }
+    for (int b = 0; b < 64; ++b)                            // reduced row echelon form
+        if (basis[b])
+            for (int c = b + 1; c < 64; ++c)
+                if (basis[c] >> b & 1) basis[c] ^= basis[b];
+    e->nhash = 0;
+    for (int f = 0; f < 64; ++f) {
+        if (!(vary >> f & 1) || basis[f]) continue;         // pivots are determined
+        uint64_t m = 1ULL << f;
+        for (int p = 0; p < 64; ++p)
+            if (basis[p] && (basis[p] >> f & 1)) m |= 1ULL << p;
+        if (e->nhash < EVSET_MAX_HASH) e->hash[e->nhash] = m;
+        ++e->nhash;
+    }
+    if (e->nhash > EVSET_MAX_HASH || (1 << e->nhash) != nclasses) {
+        int got = e->nhash;
+        e->nhash = 0;                   // does not explain the classes: keep timing
+        return -got - 1;
+    }
+    return e->nhash;
+}
+
+// Maps `bytes` of `kind` pages and calibrates the threshold. 0 on success.
+static inline int evset_init(struct evset *e, size_t bytes, enum arena_backing kind) {
+    memset(e, 0, sizeof(*e));
+    if (arena_alloc(&e->ar, bytes, kind)) return -1;
+    memset(e->ar.base, 0x5A, e->ar.bytes);
+    e->tmp = (char **)xalloc(CACHELINE, e->ar.bytes / PAGE * sizeof(char *));
+    char *v = e->ar.base;
+    cold_calibrate(v, &e->hit, &e->miss);
+    // LLC hit: touch, then sweep past L2 (<= 2 MiB on current parts) but
+    // well inside the LLC; much more and the victim goes to DRAM
+    size_t sweep = EVSET_SWEEP;
+    if (sweep > llc_bytes() / 2) sweep = llc_bytes() / 2;
+    if (sweep > e->ar.bytes / 2) sweep = e->ar.bytes / 2;
+    uint64_t t[101];
+    for (int i = 0; i < 101; ++i) {
+        (void)*(volatile char *)v;
+        for (size_t o = CACHELINE; o < sweep; o += CACHELINE) (void)*(volatile char *)(v + PAGE + o);
+        t[i] = probe_load(v);
+    }
+    qsort(t, 101, sizeof(uint64_t), cmp_u64);
+    e->llc_hit = t[50];
+    e->thr = (e->llc_hit + e->miss) / 2;
+    return 0;
+}
+
+// Associativity, set-index stride, sets per slice and slice count (plus
+// the hash with PFNs), from eviction sets of a few victims. 0 on success.
+static inline int evset_discover(struct evset *e, int print) {
+    char *set[EVSET_MAX_WAYS];
+    int ways[3], nw = 0;
+    size_t stride = 0;
+    int pa = arena_has_pa(&e->ar);
+    for (int k = 0; k < 3; ++k) {
+        char *x = e->ar.base + (size_t)(k + 1) * 7 * CACHELINE;        // arbitrary set indexes
+        int w = evset_build(e, x, PAGE, set);
+        if (print) printf("  victim +0x%zx: %s%d lines\n", (size_t)(x - e->ar.base), w < 0 ? "failed " : "", w);
+        if (w < 0) continue;
+        ways[nw++] = w;
+        // lowest bit >= 12 where the set's addresses differ from the victim's
+        uint64_t diff = 0, xa = pa ? arena_pa(&e->ar, x) : (uint64_t)(x - e->ar.base);
+        for (int i = 0; i < w; ++i)
+            diff |= (pa ? arena_pa(&e->ar, set[i]) : (uint64_t)(set[i] - e->ar.base)) ^ xa;
+        diff &= ~(uint64_t)(PAGE - 1);
+        if (!pa) diff &= e->ar.page - 1;                    // only in-page bits are physical
+        size_t s = diff ? (size_t)1 << __builtin_ctzll(diff) : e->ar.page;
+        if (s > stride) stride = s;
+    }
+    if (!nw) return -1;
+    qsort(ways, (size_t)nw, sizeof(int), evset_cmp_int);
+    e->ways = ways[nw / 2];
+    e->stride = stride;
+    e->sets = stride / CACHELINE;
+
+    // classes at set 0: lines one stride apart differ only in the slice
+    size_t lines = e->ar.bytes / e->stride;
+    if (lines > EVSET_CLASS_LINES) lines = EVSET_CLASS_LINES;
+    int *cls = (int *)xalloc(CACHELINE, lines * sizeof(int));
+    e->slices = e->nhash = 0;           // classify afresh, numbering by first appearance
+    e->slices = evset_classes(e, 0, lines, cls, -1, 0);
+    if (pa && e->slices) evset_solve_hash(e, 0, cls, lines, e->slices);
+    free(cls);
+    return e->slices ? 0 : -1;
+}
+
+static inline void evset_free(struct evset *e) {
+    free(e->tmp);
+    arena_free(&e->ar);
+    memset(e, 0, sizeof(*e));
+}
+
+#endif // EVSET_H
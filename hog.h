@@ -0,0 +1,128 @@
+// hog.h -- background memory traffic for loaded-latency measurements.
+//
+// Every probe in this repo runs on an otherwise idle machine, but latency
+// in production depends on what the neighbouring cores are streaming.
+// hog_start() launches pinned threads that each walk their own buffer
+// line by line, forward, with one of three mixes:
+//   read    one 8-byte load per line
+//   write   a full-line store per line (plus the RFO read the core issues)
+//   mixed   two lines read for every line written, as in MLC's 2:1 mix
+// After each line a thread idles for `gap_ns` (tsc_delay), which sets the
+// injection rate: gap 0 is as fast as the core can go, larger gaps back
+// off. The buffers are allocated by the threads after pinning, so first
+// touch puts them near the hogs. hog_gbps() reports what the hogs actually
+// moved (lines touched x 64 B, RFO reads not included) over a window.
+#ifndef HOG_H
+#define HOG_H
+
+#include "bench.h"
+
+#define HOG_MAX     64
+#define HOG_PUBLISH 256         // lines between updates of the shared counter
+
+enum hog_mix { HOG_READ, HOG_WRITE, HOG_MIXED, HOG_NMIX };
+__attribute__((unused))
+static const char *hog_mix_name[HOG_NMIX] = { "read", "write", "mixed" };
+
+struct hog {
+    pthread_t th;
+    int cpu;
+    enum hog_mix mix;
+    uint64_t gap;               // ticks idle after each line
+    size_t bytes;
+    const volatile int *stop;
+    pthread_barrier_t *ready;
+    volatile uint64_t lines;    // published every HOG_PUBLISH lines
+} __attribute__((aligned(CACHELINE)));
+
+struct hog_set {
+    int n;
+    volatile int stop;
+    pthread_barrier_t ready;
+    struct hog h[HOG_MAX];
+};
+
+static inline int hog_parse_mix(const char *s, enum hog_mix *out) {
+    for (int i = 0; i < HOG_NMIX; ++i)
+        if (!strcmp(s, hog_mix_name[i])) { *out = (enum hog_mix)i; return 0; }
+    fprintf(stderr, "unknown traffic mix '%s' (read, write, mixed)\n", s);
+    return -1;
+}
+
+static void *hog_run(void *arg) {
+    struct hog *h = (struct hog *)arg;
+    if (pin_cpu(h->cpu)) fprintf(stderr, "warning: could not pin hog to cpu %d\n", h->cpu);
+    char *buf = (char *)xalloc(CACHELINE, h->bytes);
+    memset(buf, 0x5A, h->bytes);
+    pthread_barrier_wait(h->ready);
+
+    size_t n = h->bytes / CACHELINE, i = 0;
+    uint64_t lines = 0, sum = 0;
+    __m128i v = _mm_set1_epi8(0x3C);
+    while (!*h->stop) {
+        for (int k = 0; k < HOG_PUBLISH; ++k) {
+            char *p = buf + i * CACHELINE;
+            int write = h->mix == HOG_WRITE || (h->mix == HOG_MIXED && lines % 3 == 2);
+            if (write) {
+                _mm_store_si128((__m128i *)p, v);
+                _mm_store_si128((__m128i *)p + 1, v);
+                _mm_store_si128((__m128i *)p + 2, v);
+                _mm_store_si128((__m128i *)p + 3, v);
+            } else {
+                sum += *(volatile uint64_t *)p;
+            }
+            if (++i == n) i = 0;
+            ++lines;
+            if (h->gap) tsc_delay(h->gap);
+        }
+        h->lines = lines;
+    }
+    asm volatile("" :: "r"(sum));
+    free(buf);
+    return NULL;
+}
+
+// Starts n hogs on cpus[0..n-1] and returns once all buffers are touched.
+// gap_ns = idle time after each line. 0 on success.
+static inline int hog_start(struct hog_set *s, int n, const int *cpus, enum hog_mix mix,
+                            double gap_ns, size_t bytes) {
+    s->n = n;
+    s->stop = 0;
+    if (n <= 0) return 0;
+    if (n > HOG_MAX) { fprintf(stderr, "hog: at most %d threads\n", HOG_MAX); return -1; }
+    pthread_barrier_init(&s->ready, NULL, (unsigned)n + 1);
+    for (int i = 0; i < n; ++i) {
+        struct hog *h = &s->h[i];
+        h->cpu = cpus[i];
+        h->mix = mix;
+        h->gap = gap_ns > 0 ? ns_ticks(gap_ns) : 0;
+        h->bytes = bytes;
+        h->stop = &s->stop;
+        h->ready = &s->ready;
+        h->lines = 0;
+        if (pthread_create(&h->th, NULL, hog_run, h)) { perror("pthread_create"); exit(1); }
+    }
+    pthread_barrier_wait(&s->ready);
+    return 0;
+}
+
+static inline uint64_t hog_lines(const struct hog_set *s) {
+    uint64_t t = 0;
+    for (int i = 0; i < s->n; ++i) t += s->h[i].lines;
+    return t;
+}
+
+// Aggregate GB/s between two hog_lines() readings `sec` seconds apart.
+static inline double hog_gbps(uint64_t lines0, uint64_t lines1, double sec) {
+    return (double)(lines1 - lines0) * CACHELINE / sec / 1e9;
+}
+
+static inline void hog_stop(struct hog_set *s) {
+    if (s->n <= 0) return;
+    s->stop = 1;
+    for (int i = 0; i < s->n; ++i) pthread_join(s->h[i].th, NULL);
+    pthread_barrier_destroy(&s->ready);
+    s->n = 0;
+}
+
+#endif // HOG_H
@@ -2,8 +2,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
+#include "sample_sink.h"
+#include "timer.h"
+#include "sampler.h"
 
-#define REPEAT 100000
+#define REPEAT 100000      // sample budget; sampling stops once the CIs converge
 #define CACHELINE 64
 
 inline void clflush(volatile void *p) {
@@ -22,13 +26,7 @@ inline void clflush_bytes(volatile void *p, size_t bytes) {
     asm volatile("mfence" ::: "memory");
 }
 
-inline uint64_t rdtsc() {
-    unsigned long a, d;
-    asm volatile("rdtsc" : "=a"(a), "=d"(d));
-    return a | ((uint64_t)d << 32);
-}
-
-inline void memtest(size_t bytes, FILE *out) {
+static inline void memtest(size_t bytes, struct sample_sink *sink, struct sampler *smp) {
     uint64_t start, end, clock;
     char *lineBuffer = (char *)malloc(bytes);
     char *lineBufferCopy = (char *)malloc(bytes);
@@ -38,32 +36,64 @@ inline void memtest(size_t bytes, FILE *out) {
     }
 
     clock = 0;
-    for (long rep = 0; rep < REPEAT; rep++) {
-        start = rdtsc();
+    sink_begin(sink, bytes);
+    sampler_reset(smp);
+    do {
+        start = tsc_raw();
         memcpy(lineBufferCopy, lineBuffer, bytes);
-        end = rdtsc();
+        end = tsc_raw();
         clflush_bytes(lineBuffer, bytes);
         clflush_bytes(lineBufferCopy, bytes);
-        clock = clock + (end - start);
-        //printf("%llu ticks to copy %zuB\n", (end - start), bytes);
-        fprintf(out, "%zu,%llu\n", bytes, (end - start));
-    }
+        uint64_t ticks = timer_net(TF_RDTSC, end - start);   // minus the rdtsc pair itself
+        clock = clock + ticks;
+        //printf("%llu ticks to copy %zuB\n", ticks, bytes);
+        sink_record(sink, ticks);
+        sampler_add(smp, ticks);
+    } while (!sampler_done(smp));
 
-    printf("took %llu ticks total\n", clock);
+    printf("took %" PRIu64 " ticks total (%.3f ms)\n", clock, ticks_ns((double)clock) / 1e6);
     free(lineBuffer);
     free(lineBufferCopy);
 }
 
 int main(int ac, char **av) {
-    FILE *out = fopen("results2.csv", "w");
-    fprintf(out, "Size(Bytes),Time(Ticks)\n");
+    struct sampler_cfg cfg = { .rel_width = 0.02, .want_p99 = 1, .min_samples = 100,
+                               .max_samples = REPEAT, .max_sec = 2.0 };
+    int want_csv = 0;
+    for (int i = 1; i < ac; ++i) {
+        if (!strcmp(av[i], "--csv")) want_csv = 1;   // optional old-style export
+        else if (!sampler_parse_arg(&cfg, ac, av, &i)) {
+            fprintf(stderr, "usage: %s [--csv] [--ci W] [--min-samples N] "
+                            "[--max-samples N] [--max-sec S]\n", av[0]);
+            return 1;
+        }
+    }
+    FILE *bin = fopen("results2.bin", "wb");
+    if (!bin) { perror("fopen"); return 1; }
+    FILE *csv = NULL;
+    if (want_csv) {
+        csv = fopen("results2.csv", "w");
+        if (!csv) { perror("fopen"); return 1; }
+        fprintf(csv, "Size(Bytes),Time(Ticks)\n");
+    }
+    struct sample_sink *sink = malloc(sizeof(*sink));
+    sink_init(sink, cfg.max_samples);
+    struct sampler smp;
+    sampler_init(&smp, &cfg);
+    timer_init(1);
     printf("------------------------------\n");
     const int exps[] = {6,7,8,9,10,11,12,13,14,15,16,20,21};
     for (int i = 0; i< 13; i++) {
         size_t bytes = (size_t) 1 << exps[i];
-        memtest(bytes, out);
+        memtest(bytes, sink, &smp);
+        sink_finish(sink, bin, csv);
+        printf("%s after %lu samples\n", sampler_stop_name[smp.stop], (unsigned long)smp.n);
         printf("------------------------------\n");
     }
-    fclose(out);
+    sampler_free(&smp);
+    sink_free(sink);
+    free(sink);
+    fclose(bin);
+    if (csv) fclose(csv);
     return 0;
 }
@@ -4,48 +4,127 @@
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
-#include <x86intrin.h>   // for _mm_clflush, __rdtscp (or use asm)
+#include "bench.h"       // clflush_range, tsc_begin/tsc_end, prefault_touch
+#include "timer.h"       // timer_init, timer_net, ticks_ns
+#include "coldpool.h"
+#include "numa.h"
+#include "pcopy.h"
+#include "hog.h"
+#include "pmu.h"
+#include "sample_sink.h"
+#include "sampler.h"
+#include "color.h"
 
+// 不再固定次数：每个尺寸一直采样到 median/p99 的置信区间足够窄，
+// REPEAT 只是样本上限，MAX_SEC 是时间上限（大尺寸不会再被flush拖上几分钟）
 #ifndef REPEAT
-#define REPEAT 1000      // 大尺寸时别用 1e6，会被flush拖垮
+#define REPEAT 1000000
 #endif
+#define CI_WIDTH 0.02    // 95% 置信区间宽度 / 分位数
+#define MIN_SAMPLES 100
+#define MAX_SEC 2.0
 #define WARMUP 10
-#define CACHELINE 64
-#define PAGE 4096
-
-static inline void clflush_range(void *p, size_t len) {
-    uintptr_t addr = (uintptr_t)p;
-    uintptr_t end  = addr + len;
-    for (; addr < end; addr += CACHELINE) {
-        _mm_clflush((void*)addr);
-    }
-    _mm_mfence();  // 确保flush完成
-}
 
-static inline uint64_t tsc_begin(void) {
-    unsigned int aux;
-    _mm_lfence();                // 序列化
-    return __rdtscp(&aux);       // 读tsc并序列化
+// --cold flush（默认）：每次采样前 clflush 两块缓冲区
+// --cold pool：轮换一个大于 LLC 的 src/dst 池，不再 clflush（见 coldpool.h）
+enum cold_mode { COLD_FLUSH, COLD_POOL };
+static enum cold_mode cold_mode = COLD_FLUSH;
+
+// --pages 4k|thp|2m|1g：src/dst 放在指定页大小的 arena 里（arena.h），
+// 用来把 DTLB miss / page walk 从缓存效应里分离出来；不给就用 posix_memalign
+static int pages_set = 0;
+static enum arena_backing pages = ARENA_THP;
+
+// --colors aliased|distinct：src/dst 从一个按物理页着色的池里拼出来（color.h），
+// dst 的第 i 页和 src 的第 i 页同色（同一组 L2 set / 同一 bank）或者两种颜色都不同；
+// src 自己的页轮流用所有颜色。bank 颜色来自 dram_map.txt（bankmap），没有就只分 cache 颜色
+enum color_mode { COLORS_OFF, COLORS_ALIASED, COLORS_DISTINCT };
+static enum color_mode colors = COLORS_OFF;
+static struct color_pool cpool;
+#define COLOR_POOL_BYTES (64UL << 20)
+
+// 硬件计数器（pmu.h）：在 TSC 计时区间外侧各读一次，差值随样本一起存
+// 打不开（虚拟机 / perf_event_paranoid）时 pmu.n == 0，行为与以前相同
+static struct pmu pmu;
+static uint64_t ctr0[PMU_NEVENTS], ctr1[PMU_NEVENTS], dctr[PMU_NEVENTS];
+
+// --pcopy N：每个尺寸在 memcpy 之后再用 N 线程的 pcopy()（pcopy.h）测一遍，
+// 样本写进 results_pcopy.bin，最后报告 pcopy 开始胜出的尺寸
+static int pcopy_threads = 0;
+static struct pcopy_pool pcp;
+
+// --load N,mix,gap_ns：测量期间在其余核上跑 N 个背景流量线程（hog.h），
+// mix 为 read|write|mixed，gap_ns 为每行之后的空闲时间（0 = 满速）
+static int load_hogs = 0;
+static enum hog_mix load_mix = HOG_READ;
+static double load_gap = 0;
+static struct hog_set hogs;
+#define HOG_BYTES (64UL << 20)
+
+static int parse_load(const char *s) {
+    char mix[16] = "read";
+    if (sscanf(s, "%d,%15[^,],%lf", &load_hogs, mix, &load_gap) < 1 || load_hogs < 0) return -1;
+    return hog_parse_mix(mix, &load_mix);
 }
 
-static inline uint64_t tsc_end(void) {
-    unsigned int aux;
-    uint64_t t = __rdtscp(&aux); // 读tsc并序列化
-    _mm_lfence();
-    return t;
+// 记录的是扣掉 lfence+rdtscp 空区间开销之后的净 tick（timer.h）
+static inline void record(struct sample_sink *sink, struct sampler *smp, uint64_t t) {
+    t = timer_net(TF_RDTSCP, t);
+    pmu_delta(&pmu, ctr0, ctr1, dctr);
+    sink_record_ctr(sink, t, dctr);
+    sampler_add(smp, t);
 }
 
-static inline void prefault_touch(char *buf, size_t bytes) {
-    // 页预触，避免首次缺页/清零被算进计时
-    for (size_t i = 0; i < bytes; i += PAGE) buf[i] = 1;
-    if (bytes > 0) buf[bytes-1] ^= 0; // 触到最后一个字节，防越界
+static void do_memcpy(void *dst, const void *src, size_t n) { memcpy(dst, src, n); }
+static void do_pcopy(void *dst, const void *src, size_t n) { pcopy(&pcp, dst, src, n); }
+
+// 冷池模式：每个样本取池里的下一对缓冲区，它们早已被其余的池子挤出 LLC
+static inline void memtest_pool(size_t bytes, copy_fn copy, struct sample_sink *sink,
+                                struct sampler *smp) {
+    struct cold_pool pool;
+    if (cold_pool_init(&pool, bytes, llc_bytes(), pages)) exit(1);
+    // 校验（兼预热）：确认拷贝前的行确实 miss
+    cold_pool_verify(&pool, copy, 1);
+
+    sink_begin(sink, bytes);
+    sampler_reset(smp);
+    do {
+        char *src, *dst;
+        cold_pool_next(&pool, &src, &dst);
+
+        pmu_read(&pmu, ctr0);
+        uint64_t t0 = tsc_begin();
+        copy(dst, src, bytes);
+        uint64_t t1 = tsc_end();
+        pmu_read(&pmu, ctr1);
+        asm volatile("" :: "r"(dst[0]) : "memory");
+
+        record(sink, smp, t1 - t0);
+    } while (!sampler_done(smp));
+
+    cold_pool_free(&pool);
 }
 
-static inline void memtest(size_t bytes, FILE *out) {
+// copy 是被测的拷贝函数：do_memcpy 或 do_pcopy（内联后就是直接调用）
+static inline void memtest(size_t bytes, copy_fn copy, struct sample_sink *sink,
+                           struct sampler *smp) {
+    if (cold_mode == COLD_POOL) { memtest_pool(bytes, copy, sink, smp); return; }
+
     // 64B 对齐分配（避免跨行边界的无谓抖动）
     char *src, *dst;
-    if (posix_memalign((void**)&src, CACHELINE, bytes) ||
-        posix_memalign((void**)&dst, CACHELINE, bytes)) {
+    struct arena src_ar, dst_ar;
+    struct color_buf src_cb, dst_cb;
+    if (colors) {
+        if (color_alloc(&cpool, &src_cb, bytes, COLOR_ANY, COLOR_ANY) ||
+            color_alloc_like(&cpool, &dst_cb, &src_cb, colors == COLORS_ALIASED)) exit(1);
+        src = src_cb.base;
+        dst = dst_cb.base;
+    } else if (pages_set) {
+        if (arena_alloc(&src_ar, bytes, pages) || arena_alloc(&dst_ar, bytes, pages)) exit(1);
+        src = src_ar.base;
+        dst = dst_ar.base;
+    } else if (posix_memalign((void**)&src, CACHELINE, bytes) ||
+               posix_memalign((void**)&dst, CACHELINE, bytes)) {
         perror("posix_memalign"); exit(1);
     }
 
@@ -59,41 +138,199 @@ static inline void memtest(size_t bytes, FILE *out) {
     for (int r = 0; r < WARMUP; ++r) {
         clflush_range(src, bytes);
         clflush_range(dst, bytes);
-        (void)memcpy(dst, src, bytes);
+        copy(dst, src, bytes);
     }
 
-    // 正式测量
-    for (int r = 0; r < REPEAT; ++r) {
+    // 正式测量：直到置信区间收敛或预算用完
+    sink_begin(sink, bytes);
+    sampler_reset(smp);
+    do {
         // 为当前迭代制造“冷”条件：把本次会触达的行都flush
         clflush_range(src, bytes);
         clflush_range(dst, bytes);
 
+        pmu_read(&pmu, ctr0);
         uint64_t t0 = tsc_begin();
-        memcpy(dst, src, bytes);
+        copy(dst, src, bytes);
         uint64_t t1 = tsc_end();
+        pmu_read(&pmu, ctr1);
 
         // 防止编译器把 memcpy 优化掉
         // （观察一个字节，使其对外可见）
         asm volatile("" :: "r"(dst[0]) : "memory");
 
-        // 仅记录CSV，避免stdout抖动
-        fprintf(out, "%zu,%" PRIu64 "\n", bytes, (t1 - t0));
+        // 只写入预分配的 ring/直方图，计时区间之间不碰 stdio
+        record(sink, smp, t1 - t0);
+    } while (!sampler_done(smp));
+
+    if (colors) {
+        color_free(&cpool, &src_cb);
+        color_free(&cpool, &dst_cb);
+    } else if (pages_set) {
+        arena_free(&src_ar);
+        arena_free(&dst_ar);
+    } else {
+        free(src);
+        free(dst);
     }
+}
 
-    free(src);
-    free(dst);
+static void report(size_t bytes, const struct sampler *smp) {
+    printf("          %s after %" PRIu64 " samples (median CI %.2f%%, p99 CI %.2f%%)\n",
+           sampler_stop_name[smp->stop], smp->n, 100 * smp->med_width, 100 * smp->p99_width);
+    if (smp->median)
+        printf("          p50 %.1f ns, %.2f B/tick, %.2f GB/s\n", ticks_ns((double)smp->median),
+               (double)bytes / (double)smp->median, (double)bytes / ticks_ns((double)smp->median));
 }
 
-int main(void) {
-    FILE *out = fopen("results.csv", "w");
-    if (!out) { perror("fopen"); return 1; }
-    fprintf(out, "Size(Bytes),Time(Ticks)\n");
+int main(int ac, char **av) {
+    // --csv: 额外导出旧格式 results.csv（默认只写 results.bin）
+    // --ci W --min-samples N --max-samples N --max-sec S: 采样控制
+    // --cold flush|pool: 冷缓存方式
+    // --no-pmu: 不开硬件计数器
+    // --pages 4k|thp|2m|1g: 缓冲区页大小（冷池模式默认 thp）
+    // --colors aliased|distinct: src/dst 按页着色（着色池用 --pages 的 4k 或 thp）
+    // --pcopy N: 同时测 N 线程并行拷贝，和 memcpy 对比
+    // --load N,mix,gap_ns: 背景带宽线程（loaded latency）
+    // --cpu-node N --mem-node N: 绑定运行节点 / 内存节点（numa.h），默认不管
+    struct sampler_cfg cfg = { .rel_width = CI_WIDTH, .want_p99 = 1,
+                               .min_samples = MIN_SAMPLES, .max_samples = REPEAT,
+                               .max_sec = MAX_SEC };
+    int want_csv = 0, want_pmu = 1, cpu_node = -1, mem_node = -1;
+    for (int i = 1; i < ac; ++i) {
+        if (!strcmp(av[i], "--csv")) want_csv = 1;
+        else if (!strcmp(av[i], "--no-pmu")) want_pmu = 0;
+        else if (!strcmp(av[i], "--pcopy") && i + 1 < ac) pcopy_threads = atoi(av[++i]);
+        else if (!strcmp(av[i], "--load") && i + 1 < ac) {
+            if (parse_load(av[++i])) return 1;
+        }
+        else if (!strcmp(av[i], "--pages") && i + 1 < ac) {
+            if (arena_parse_backing(av[++i], &pages)) return 1;
+            pages_set = 1;
+        }
+        else if (!strcmp(av[i], "--colors") && i + 1 < ac) {
+            ++i;
+            if (!strcmp(av[i], "aliased")) colors = COLORS_ALIASED;
+            else if (!strcmp(av[i], "distinct")) colors = COLORS_DISTINCT;
+            else { fprintf(stderr, "--colors aliased|distinct\n"); return 1; }
+        }
+        else if (!strcmp(av[i], "--cold") && i + 1 < ac) {
+            ++i;
+            if (!strcmp(av[i], "flush")) cold_mode = COLD_FLUSH;
+            else if (!strcmp(av[i], "pool")) cold_mode = COLD_POOL;
+            else { fprintf(stderr, "--cold flush|pool\n"); return 1; }
+        }
+        else if (numa_parse_arg(&cpu_node, &mem_node, ac, av, &i)) continue;
+        else if (!sampler_parse_arg(&cfg, ac, av, &i)) {
+            fprintf(stderr, "usage: %s [--csv] [--cold flush|pool] [--pages 4k|thp|2m|1g] [--colors aliased|distinct] [--pcopy N] [--load N,read|write|mixed,gap_ns] [--no-pmu] [--cpu-node N] [--mem-node N] "
+                            "[--ci W] [--min-samples N] [--max-samples N] [--max-sec S]\n", av[0]);
+            return 1;
+        }
+    }
+
+    numa_apply(cpu_node, mem_node);     // 在任何分配之前
+    if (pages_set) printf("buffers on %s pages\n", arena_backing_name[pages]);
+    if (colors) {
+        // 着色池在 numa_apply 之后分配，页落在 --mem-node 上
+        struct dram_map map;
+        int have_map = !dram_map_load(&map, DRAM_MAP_FILE);
+        if (color_pool_init(&cpool, COLOR_POOL_BYTES, pages, have_map ? &map : NULL)) return 1;
+        printf("colored buffers (%s): %d cache x %d bank colors, %s, PFNs %s\n",
+               colors == COLORS_ALIASED ? "aliased" : "distinct", cpool.ncache, cpool.nbank,
+               have_map ? DRAM_MAP_FILE : "no " DRAM_MAP_FILE,
+               arena_has_pa(&cpool.ar) ? "visible" : "hidden (in-page bits only)");
+        if (cpool.ncolors == 1) fprintf(stderr, "warning: only one color, aliased and distinct are the same\n");
+        if (cold_mode == COLD_POOL) fprintf(stderr, "warning: --colors is ignored with --cold pool\n");
+    }
+    timer_init(1);
+    static struct sample_sink sink;
+    sink_init(&sink, cfg.max_samples);
+    if (want_pmu && pmu_open(&pmu, 1))
+        sink_attach_counters(&sink, (unsigned)pmu.n, pmu.name);
+    printf("counters: %d%s\n", pmu.n, pmu.use_rdpmc ? " (rdpmc)" : pmu.n ? " (read)" : "");
+
+    FILE *bin = fopen("results.bin", "wb");
+    if (!bin) { perror("fopen"); return 1; }
+    FILE *csv = NULL;
+    if (want_csv) {
+        csv = fopen("results.csv", "w");
+        if (!csv) { perror("fopen"); return 1; }
+        sink_csv_header(&sink, csv);
+    }
+    int cpus[PCOPY_MAX_THREADS + HOG_MAX];
+    int ncpus = allowed_cpus(cpus, PCOPY_MAX_THREADS + HOG_MAX);
+    FILE *bin_par = NULL;
+    if (pcopy_threads) {
+        if (pcopy_threads > ncpus) {
+            fprintf(stderr, "--pcopy %d: only %d CPUs available\n", pcopy_threads, ncpus);
+            return 1;
+        }
+        // 主线程固定在 cpus[0]（memcpy 基线也在这里跑）；超过半个 LLC 用 NT store
+        if (pcopy_init(&pcp, pcopy_threads, cpus, llc_bytes() / 2)) return 1;
+        printf("pcopy: %d threads, streaming stores from %zu B\n", pcopy_threads, pcp.nt_min);
+        bin_par = fopen("results_pcopy.bin", "wb");
+        if (!bin_par) { perror("fopen"); return 1; }
+    }
+    if (load_hogs) {
+        // 背景线程用 pcopy 之后剩下的核；主线程留在 cpus[0]
+        int first = pcopy_threads > 1 ? pcopy_threads : 1, hog_cpus[HOG_MAX];
+        if (load_hogs > HOG_MAX) { fprintf(stderr, "--load: at most %d threads\n", HOG_MAX); return 1; }
+        if (first + load_hogs > ncpus)
+            fprintf(stderr, "warning: %d hogs on %d free CPU(s), they will share cores\n",
+                    load_hogs, ncpus > first ? ncpus - first : 0);
+        for (int i = 0; i < load_hogs; ++i)
+            hog_cpus[i] = cpus[ncpus > first ? first + i % (ncpus - first) : 0];
+        if (!pcopy_threads) pin_cpu(cpus[0]);
+        if (hog_start(&hogs, load_hogs, hog_cpus, load_mix, load_gap, HOG_BYTES)) return 1;
+        printf("load: %d %s hog(s), %.0f ns gap\n", load_hogs, hog_mix_name[load_mix], load_gap);
+    }
+    struct sampler smp;
+    sampler_init(&smp, &cfg);
 
     const int exps[] = {6,7,8,9,10,11,12,13,14,15,16,20,21};
-    for (size_t i = 0; i < sizeof(exps)/sizeof(exps[0]); ++i) {
+    const size_t nexps = sizeof(exps)/sizeof(exps[0]);
+    uint64_t med_lib[sizeof(exps)/sizeof(exps[0])], med_par[sizeof(exps)/sizeof(exps[0])];
+    for (size_t i = 0; i < nexps; ++i) {
         size_t bytes = (size_t)1 << exps[i];
-        memtest(bytes, out);
+        uint64_t l0 = hog_lines(&hogs);
+        double t0 = now_sec();
+        memtest(bytes, do_memcpy, &sink, &smp);
+        double t1 = now_sec();
+        sink_finish(&sink, bin, csv);   // 每个尺寸结束后才落盘
+        report(bytes, &smp);
+        if (load_hogs)
+            printf("          background %.2f GB/s\n", hog_gbps(l0, hog_lines(&hogs), t1 - t0));
+        med_lib[i] = smp.median;
+        if (pcopy_threads) {
+            printf("  pcopy x%d:\n", pcopy_threads);
+            memtest(bytes, do_pcopy, &sink, &smp);
+            sink_finish(&sink, bin_par, NULL);
+            report(bytes, &smp);
+            med_par[i] = smp.median;
+        }
+    }
+    if (pcopy_threads) {
+        // 从最大尺寸往回找：pcopy 一直更快的最小尺寸
+        int from = -1;
+        for (int i = (int)nexps - 1; i >= 0 && med_par[i] < med_lib[i]; --i) from = i;
+        if (from < 0)
+            printf("pcopy x%d: glibc memcpy wins at %zu B\n", pcopy_threads,
+                   (size_t)1 << exps[nexps - 1]);
+        else
+            printf("pcopy x%d: faster than memcpy from %zu B (%.2fx there, %.2fx at %zu B)\n",
+                   pcopy_threads, (size_t)1 << exps[from],
+                   (double)med_lib[from] / (double)med_par[from],
+                   (double)med_lib[nexps - 1] / (double)med_par[nexps - 1],
+                   (size_t)1 << exps[nexps - 1]);
+        pcopy_destroy(&pcp);
+        fclose(bin_par);
     }
-    fclose(out);
+    hog_stop(&hogs);
+    if (colors) color_pool_free(&cpool);
+    sampler_free(&smp);
+    pmu_close(&pmu);
+    sink_free(&sink);
+    fclose(bin);
+    if (csv) fclose(csv);
     return 0;
 }
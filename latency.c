@@ -0,0 +1,221 @@
+// latency.c -- lat_mem_rd-style pointer chasing across the memory hierarchy.
+//
+// memtest() times whole copies, where out-of-order overlap and the hardware
+// prefetchers hide the latency of each load. Here every load depends on the
+// previous one: the working set is turned into one random cycle of 64B
+// lines (Sattolo's algorithm), so each step is a single, unprefetchable
+// miss at whatever level the set fits in.
+//
+// Two sweeps, four points per octave:
+//   cache: random line chain over sets from 4 KiB to -M MiB, on -p pages
+//          (default THP);
+//   tlb:   one line per 4 KiB stride (offsets staggered across cache sets),
+//          random order, so the data stays cached and the rise comes
+//          from DTLB / STLB misses and page walks.
+// The tlb sweep runs once per backing in -b (default 4k). The touched
+// lines -- and so the cache footprint -- are identical for every backing;
+// only the number of pages behind them changes, so the gap between the
+// 4k curve and a 2m/1g curve at the same point is the page-walk cost.
+// Plateau edges are reported as L1/L2/L3/DRAM and TLB reach (from the 4k
+// curve if it ran), and written as a JSON topology profile (-o, default
+// topology.json).
+//
+// usage: ./latency [-M max_MiB] [-P max_pages] [-p backing] [-b 4k,thp,2m,1g] [-o topology.json]
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <math.h>
+#include "bench.h"
+#include "arena.h"
+#include "chase.h"
+
+#define STEPS_PER_OCTAVE 4
+#define MIN_LOADS   (1L << 21)
+#define MAX_LOADS   (1L << 25)
+#define JUMP_RATIO  1.15      // latency ratio across one step that counts as an edge
+#define MAX_POINTS  128
+#define MAX_EDGES   8
+
+struct point { size_t x; double ns; };   // x = bytes (cache) or pages (tlb)
+
+static long loads_for(size_t nodes) {
+    long l = (long)nodes * 4;
+    if (l < MIN_LOADS) l = MIN_LOADS;
+    if (l > MAX_LOADS) l = MAX_LOADS;
+    return l;
+}
+
+// Random cycle over every line of the first `bytes` of `base`.
+static double cache_point(char *base, size_t bytes, uint32_t *perm) {
+    size_t n = bytes / CACHELINE;
+    return chase_ns(chase_link(base, CACHELINE, n, perm), loads_for(n));
+}
+
+// One line per 4 KiB, line offset staggered so the lines spread over sets.
+static inline char *page_line(char *base, size_t i) {
+    return base + i * PAGE + ((i * 7) % (PAGE / CACHELINE)) * CACHELINE;
+}
+
+static double tlb_point(char *base, size_t pages, uint32_t *perm) {
+    chase_cycle(perm, pages);
+    for (size_t i = 0; i < pages; ++i)
+        *(void **)page_line(base, i) = page_line(base, perm[i]);
+    return chase_ns((void **)page_line(base, 0), loads_for(pages));
+}
+
+// Edges: steps whose latency ratio exceeds JUMP_RATIO and is the largest
+// within one octave either side. Returns the index of the last point
+// *before* each rise.
+static int find_edges(const struct point *pt, int n, int *edge) {
+    int ne = 0;
+    for (int i = 1; i < n && ne < MAX_EDGES; ++i) {
+        double r = pt[i].ns / pt[i - 1].ns;
+        if (r < JUMP_RATIO) continue;
+        int best = 1;
+        for (int j = i - STEPS_PER_OCTAVE; j <= i + STEPS_PER_OCTAVE; ++j)
+            if (j >= 1 && j < n && j != i && pt[j].ns / pt[j - 1].ns > r) best = 0;
+        if (best) edge[ne++] = i - 1;
+    }
+    return ne;
+}
+
+static int sweep(size_t lo, size_t hi, size_t unit, struct point *pt,
+                 double (*fn)(char *, size_t, uint32_t *), char *base, uint32_t *perm,
+                 const char *label) {
+    int n = 0;
+    for (int k = 0; n < MAX_POINTS; ++k) {
+        size_t x = (size_t)((double)lo * pow(2.0, (double)k / STEPS_PER_OCTAVE));
+        x = x / unit * unit;
+        if (x > hi) break;
+        if (n && x == pt[n - 1].x) continue;
+        pt[n].x = x;
+        pt[n].ns = fn(base, x, perm);
+        printf("  %-5s %12zu %s  %8.2f ns\n", label, x, unit == 1 ? "pages" : "B    ", pt[n].ns);
+        fflush(stdout);
+        ++n;
+    }
+    return n;
+}
+
+// Parses "4k,2m" into a backing list; returns the count or -1.
+static int parse_backings(const char *s, enum arena_backing *kinds) {
+    char buf[64];
+    int n = 0;
+    snprintf(buf, sizeof(buf), "%s", s);
+    for (char *save = NULL, *tok = strtok_r(buf, ",", &save); tok && n < ARENA_1G + 1;
+         tok = strtok_r(NULL, ",", &save))
+        if (arena_parse_backing(tok, &kinds[n++])) return -1;
+    return n;
+}
+
+int main(int ac, char **av) {
+    size_t max_mb = 1024, max_pages = 16384;   // 16K lines = 1 MiB, stays in L2
+    const char *out_path = "topology.json";
+    enum arena_backing cache_kind = ARENA_THP, tlb_kind[ARENA_1G + 1] = { ARENA_4K };
+    int ntlb_kind = 1;
+    int opt;
+    while ((opt = getopt(ac, av, "M:P:p:b:o:")) != -1) {
+        switch (opt) {
+        case 'M': max_mb = (size_t)atol(optarg); break;
+        case 'P': max_pages = (size_t)atol(optarg); break;
+        case 'p': if (arena_parse_backing(optarg, &cache_kind)) goto usage; break;
+        case 'b': if ((ntlb_kind = parse_backings(optarg, tlb_kind)) < 1) goto usage; break;
+        case 'o': out_path = optarg; break;
+        default:  goto usage;
+        }
+    }
+    size_t max_bytes = max_mb << 20;
+    size_t max_nodes = max_bytes / CACHELINE > max_pages ? max_bytes / CACHELINE : max_pages;
+    uint32_t *perm = (uint32_t *)xalloc(CACHELINE, max_nodes * sizeof(uint32_t));
+
+    static struct point cpt[MAX_POINTS], tpts[ARENA_1G + 1][MAX_POINTS];
+    int ntp[ARENA_1G + 1] = { 0 };
+    struct arena ar;
+
+    printf("cache sweep (random line chain, %s pages)\n", arena_backing_name[cache_kind]);
+    if (arena_alloc(&ar, max_bytes, cache_kind)) return 1;
+    int nc = sweep(4096, max_bytes, CACHELINE, cpt, cache_point, ar.base, perm, "cache");
+    arena_free(&ar);
+
+    int ref = -1;                       // curve the TLB edges come from
+    for (int b = 0; b < ntlb_kind; ++b) {
+        printf("tlb sweep (one line per 4 KiB, %s pages)\n", arena_backing_name[tlb_kind[b]]);
+        if (arena_alloc(&ar, max_pages * PAGE, tlb_kind[b])) {
+            printf("  %s pages unavailable, skipped\n", arena_backing_name[tlb_kind[b]]);
+            continue;
+        }
+        ntp[b] = sweep(8, max_pages, 1, tpts[b], tlb_point, ar.base, perm, "tlb");
+        arena_free(&ar);
+        if (ref < 0 || (tlb_kind[b] == ARENA_4K && tlb_kind[ref] != ARENA_4K)) ref = b;
+    }
+    if (ref < 0) return 1;
+    const struct point *tpt = tpts[ref];
+    int nt = ntp[ref];
+
+    if (ntlb_kind > 1) {                // same lines, different page sizes
+        printf("\nstride sweep by backing (ns per load):\n  %8s", "pages");
+        for (int b = 0; b < ntlb_kind; ++b) if (ntp[b]) printf(" %9s", arena_backing_name[tlb_kind[b]]);
+        printf("\n");
+        for (int i = 0; i < nt; ++i) {
+            printf("  %8zu", tpt[i].x);
+            for (int b = 0; b < ntlb_kind; ++b)
+                if (ntp[b]) printf(" %9.2f", i < ntp[b] ? tpts[b][i].ns : 0.0);
+            printf("\n");
+        }
+        for (int b = 0; b < ntlb_kind; ++b)
+            if (b != ref && ntp[b] == nt)
+                printf("  page-walk cost vs %s at %zu pages: %+.2f ns per load\n",
+                       arena_backing_name[tlb_kind[b]], tpt[nt - 1].x,
+                       tpt[nt - 1].ns - tpts[b][nt - 1].ns);
+    }
+
+    int ce[MAX_EDGES], te[MAX_EDGES];
+    int nce = find_edges(cpt, nc, ce), nte = find_edges(tpt, nt, te);
+
+    static const char *cname[] = { "L1", "L2", "L3", "L4" };
+    static const char *tname[] = { "L1 dTLB", "STLB", "TLB3" };
+    printf("\ndetected hierarchy:\n");
+    for (int i = 0; i < nce && i < 4; ++i)
+        printf("  %-4s <= %10zu B   %7.2f ns\n", cname[i], cpt[ce[i]].x, cpt[ce[i]].ns);
+    printf("  DRAM          %7.2f ns (at %zu MiB)\n", cpt[nc - 1].ns, cpt[nc - 1].x >> 20);
+    for (int i = 0; i < nte && i < 3; ++i)
+        printf("  %-7s reach %6zu pages (%zu KiB), %+.2f ns per miss beyond\n", tname[i],
+               tpt[te[i]].x, tpt[te[i]].x * PAGE >> 10, tpt[te[i] + 1].ns - tpt[te[i]].ns);
+
+    FILE *f = fopen(out_path, "w");
+    if (!f) { perror(out_path); return 1; }
+    fprintf(f, "{\n  \"caches\": [");
+    for (int i = 0; i < nce && i < 4; ++i)
+        fprintf(f, "%s\n    {\"name\": \"%s\", \"size_bytes\": %zu, \"latency_ns\": %.2f}",
+                i ? "," : "", cname[i], cpt[ce[i]].x, cpt[ce[i]].ns);
+    fprintf(f, "\n  ],\n  \"dram_latency_ns\": %.2f,\n  \"tlb\": [", cpt[nc - 1].ns);
+    for (int i = 0; i < nte && i < 3; ++i)
+        fprintf(f, "%s\n    {\"name\": \"%s\", \"reach_pages\": %zu, \"reach_bytes\": %zu}",
+                i ? "," : "", tname[i], tpt[te[i]].x, tpt[te[i]].x * PAGE);
+    fprintf(f, "\n  ],\n  \"cache_curve\": [");
+    for (int i = 0; i < nc; ++i)
+        fprintf(f, "%s[%zu, %.2f]", i ? ", " : "", cpt[i].x, cpt[i].ns);
+    fprintf(f, "],\n  \"tlb_curve\": [");
+    for (int i = 0; i < nt; ++i)
+        fprintf(f, "%s[%zu, %.2f]", i ? ", " : "", tpt[i].x, tpt[i].ns);
+    fprintf(f, "],\n  \"tlb_curve_backing\": \"%s\",\n  \"stride_sweep\": {",
+            arena_backing_name[tlb_kind[ref]]);
+    for (int b = 0, first = 1; b < ntlb_kind; ++b) {
+        if (!ntp[b]) continue;
+        fprintf(f, "%s\n    \"%s\": [", first ? "" : ",", arena_backing_name[tlb_kind[b]]);
+        for (int i = 0; i < ntp[b]; ++i)
+            fprintf(f, "%s[%zu, %.2f]", i ? ", " : "", tpts[b][i].x, tpts[b][i].ns);
+        fprintf(f, "]");
+        first = 0;
+    }
+    fprintf(f, "\n  }\n}\n");
+    fclose(f);
+    printf("wrote %s\n", out_path);
+
+    free(perm);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-M max_MiB] [-P max_pages] [-p 4k|thp|2m|1g] [-b 4k,thp,2m,1g] "
+                    "[-o topology.json]\n", av[0]);
+    return 1;
+}
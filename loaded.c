@@ -0,0 +1,189 @@
+// loaded.c -- MLC-style loaded latency: latency vs background bandwidth.
+//
+// One reserved core (the first allowed CPU) runs a latency probe while -t
+// hog threads on the other cores stream read, write or mixed traffic
+// (hog.h). For each traffic mix the hogs' injection gap is swept from -g's
+// list (ns idle per line; 0 = flat out), and every point reports the
+// bandwidth the hogs actually moved during the probe and the probe's
+// latency. Plotting one against the other gives the usual loaded-latency
+// curve per mix; the first row of each table is the idle machine.
+//
+// Probes (-m):
+//   chase  random pointer chase over -M MiB (chase.h), ns per load
+//   aba    median of time_ABA() over ABA_PAIRS partners of A (rowprobe.h)
+//   copy   memtest()'s cold memcpy of -s bytes (clflush src/dst, then
+//          lfence+rdtscp around memcpy), median ns
+//
+// usage: ./loaded [-m chase|aba|copy] [-t hogs] [-x read,write,mixed] [-g gap_ns,...]
+//                 [-M chase_MiB] [-H hog_MiB] [-s copy_bytes] [-o loaded.csv]
+#define _GNU_SOURCE
+#include <unistd.h>
+#include "bench.h"
+#include "arena.h"
+#include "chase.h"
+#include "rowprobe.h"
+#include "hog.h"
+
+#define MAX_GAPS     32
+#define CHASE_LOADS  (1L << 22)
+#define ABA_PAIRS    16
+#define ABA_STRIDE   (64 * 1024)
+#define COPY_SAMPLES 201
+#define SETTLE_SEC   0.05       // hogs run this long before the probe starts
+
+enum probe { P_CHASE, P_ABA, P_COPY, NPROBES };
+static const char *probe_name[NPROBES] = { "chase", "aba", "copy" };
+
+static struct arena ar;
+static void **chain;
+static char *copy_src, *copy_dst;
+static size_t copy_bytes = 65536;
+
+static double probe_aba(void) {
+    uint64_t med[ABA_PAIRS];
+    for (int k = 0; k < ABA_PAIRS; ++k)
+        med[k] = time_ABA(ar.base, ar.base + (size_t)(k + 1) * ABA_STRIDE);
+    qsort(med, ABA_PAIRS, sizeof(uint64_t), cmp_u64);
+    return ticks_ns((double)med[ABA_PAIRS / 2]);
+}
+
+static double probe_copy(void) {
+    static uint64_t t[COPY_SAMPLES];
+    for (int i = 0; i < COPY_SAMPLES; ++i) {
+        clflush_range(copy_src, copy_bytes);
+        clflush_range(copy_dst, copy_bytes);
+        uint64_t t0 = tsc_begin();
+        memcpy(copy_dst, copy_src, copy_bytes);
+        uint64_t t1 = tsc_end();
+        asm volatile("" :: "r"(copy_dst[0]) : "memory");
+        t[i] = timer_net(TF_RDTSCP, t1 - t0);
+    }
+    qsort(t, COPY_SAMPLES, sizeof(uint64_t), cmp_u64);
+    return ticks_ns((double)t[COPY_SAMPLES / 2]);
+}
+
+static double probe(enum probe p) {
+    switch (p) {
+    case P_CHASE: return chase_ns(chain, CHASE_LOADS);
+    case P_ABA:   return probe_aba();
+    default:      return probe_copy();
+    }
+}
+
+// Parses "a,b,c" into doubles; returns the count or -1.
+static int parse_list(const char *s, double *v, int max) {
+    char buf[256];
+    int n = 0;
+    snprintf(buf, sizeof(buf), "%s", s);
+    for (char *save = NULL, *tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        if (n == max) return -1;
+        v[n++] = atof(tok);
+    }
+    return n;
+}
+
+static int parse_mixes(const char *s, enum hog_mix *m) {
+    char buf[64];
+    int n = 0;
+    snprintf(buf, sizeof(buf), "%s", s);
+    for (char *save = NULL, *tok = strtok_r(buf, ",", &save); tok && n < HOG_NMIX;
+         tok = strtok_r(NULL, ",", &save))
+        if (hog_parse_mix(tok, &m[n++])) return -1;
+    return n;
+}
+
+int main(int ac, char **av) {
+    enum probe pr = P_CHASE;
+    int nhogs = -1;
+    enum hog_mix mixes[HOG_NMIX] = { HOG_READ, HOG_WRITE, HOG_MIXED };
+    int nmix = HOG_NMIX;
+    double gaps[MAX_GAPS] = { 0, 10, 25, 50, 100, 200, 400, 800, 1600 };
+    int ngaps = 9;
+    size_t chase_mb = 128, hog_mb = 64;
+    const char *out_path = "loaded.csv";
+    int opt;
+    while ((opt = getopt(ac, av, "m:t:x:g:M:H:s:o:")) != -1) {
+        switch (opt) {
+        case 'm':
+            for (pr = 0; pr < NPROBES && strcmp(optarg, probe_name[pr]); ++pr) {}
+            if (pr == NPROBES) goto usage;
+            break;
+        case 't': nhogs = atoi(optarg); break;
+        case 'x': if ((nmix = parse_mixes(optarg, mixes)) < 1) goto usage; break;
+        case 'g': if ((ngaps = parse_list(optarg, gaps, MAX_GAPS)) < 1) goto usage; break;
+        case 'M': chase_mb = (size_t)atol(optarg); break;
+        case 'H': hog_mb = (size_t)atol(optarg); break;
+        case 's': copy_bytes = (size_t)atol(optarg); break;
+        case 'o': out_path = optarg; break;
+        default:  goto usage;
+        }
+    }
+
+    int cpus[HOG_MAX + 1];
+    int ncpus = allowed_cpus(cpus, HOG_MAX + 1);
+    if (nhogs < 0) nhogs = ncpus - 1;
+    if (nhogs > HOG_MAX) goto usage;
+    int hog_cpus[HOG_MAX];
+    for (int i = 0; i < nhogs; ++i)            // the probe keeps cpus[0] to itself if it can
+        hog_cpus[i] = cpus[ncpus > 1 ? 1 + i % (ncpus - 1) : 0];
+    if (pin_cpu(cpus[0])) fprintf(stderr, "warning: could not pin to cpu %d\n", cpus[0]);
+    if (nhogs && (ncpus < 2 || nhogs > ncpus - 1))
+        fprintf(stderr, "warning: %d hogs on %d other CPU(s), they will share cores\n",
+                nhogs, ncpus - 1);
+    timer_init(1);
+
+    if (arena_alloc(&ar, chase_mb << 20, ARENA_THP)) return 1;
+    memset(ar.base, 0, ar.bytes);
+    if (pr == P_CHASE) {
+        uint32_t *perm = (uint32_t *)xalloc(CACHELINE, ar.bytes / CACHELINE * sizeof(uint32_t));
+        chain = chase_link(ar.base, CACHELINE, ar.bytes / CACHELINE, perm);
+        free(perm);
+    } else if (pr == P_COPY) {
+        copy_src = (char *)xalloc(CACHELINE, copy_bytes);
+        copy_dst = (char *)xalloc(CACHELINE, copy_bytes);
+        memset(copy_src, 0xA5, copy_bytes);
+        memset(copy_dst, 0, copy_bytes);
+    }
+
+    FILE *out = fopen(out_path, "w");
+    if (!out) { perror(out_path); return 1; }
+    fprintf(out, "Probe,Mix,Hogs,GapNs,HogGBps,LatencyNs\n");
+    printf("probe %s on cpu %d, %d hog(s) of %zu MiB each\n", probe_name[pr], cpus[0], nhogs, hog_mb);
+
+    double idle = probe(pr);
+    printf("idle: %.2f ns\n", idle);
+    fprintf(out, "%s,idle,0,0,0,%.2f\n", probe_name[pr], idle);
+
+    static struct hog_set hogs;
+    for (int m = 0; m < nmix && nhogs; ++m) {
+        printf("\n%s traffic\n  %8s %10s %10s %8s\n", hog_mix_name[mixes[m]],
+               "gap ns", "hog GB/s", "lat ns", "x idle");
+        for (int g = 0; g < ngaps; ++g) {
+            if (hog_start(&hogs, nhogs, hog_cpus, mixes[m], gaps[g], hog_mb << 20)) return 1;
+            double t0 = now_sec();
+            while (now_sec() - t0 < SETTLE_SEC) {}
+            uint64_t l0 = hog_lines(&hogs);
+            t0 = now_sec();
+            double lat = probe(pr);
+            double t1 = now_sec();
+            double gbps = hog_gbps(l0, hog_lines(&hogs), t1 - t0);
+            hog_stop(&hogs);
+            printf("  %8.0f %10.2f %10.2f %8.2f\n", gaps[g], gbps, lat, lat / idle);
+            fprintf(out, "%s,%s,%d,%.0f,%.3f,%.2f\n", probe_name[pr], hog_mix_name[mixes[m]],
+                    nhogs, gaps[g], gbps, lat);
+            fflush(stdout);
+        }
+    }
+    printf("wrote %s\n", out_path);
+
+    fclose(out);
+    free(copy_src);
+    free(copy_dst);
+    arena_free(&ar);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-m chase|aba|copy] [-t hogs] [-x read,write,mixed] [-g gap_ns,...]\n"
+                    "       [-M chase_MiB] [-H hog_MiB] [-s copy_bytes] [-o loaded.csv]\n", av[0]);
+    return 1;
+}
@@ -0,0 +1,571 @@
+// matrix.c -- declarative experiment matrix: randomized, interleaved, resumable.
+//
+// The sweeps in the other programs are hard-coded (exps[], ROW_STRIDE,
+// ARENA_MB, SCAN_STRIDE) and run in order, so any thermal or frequency
+// drift over a run lands on one end of the size axis. This driver reads a
+// matrix from a config file, expands every block into the cartesian
+// product of its axes, and runs the cells x repeats in a seeded random
+// order, so drift turns into noise that is spread over all cells.
+//
+// Config (see matrix.conf): global "seed" / "repeat" lines, then blocks
+//   [name]
+//   bench    chase,read,copy,aba
+//   size     4K..64M,96M          (K/M/G; a..b doubles from a to b)
+//   pattern  rand,seq-fwd,stride-256     (default: the bench's own)
+//   threads  1,2,4
+//   pages    4k,thp,2m,1g
+//   cpu      0,2                  (first CPU; threads take the next allowed ones)
+//   repeat   5
+// Benchmarks, one worker thread per `threads`, each on its own arena:
+//   chase  dependent loads through `size` bytes in a walk.h order (default
+//          rand), ns per load, mean over threads
+//   read   independent loads in a walk.h order (default seq-fwd), GB/s summed
+//   copy   `size` bytes src -> dst with a copy_kernels.h kernel (default
+//          libc), back to back and so warm, GB/s summed
+//   aba    time_ABA() of A and A + size (rowprobe.h), median ns; 1 thread
+// Combinations a benchmark cannot run (copy kernels as a walk order, aba
+// with threads > 1, a CPU outside the affinity mask, ...) are dropped and
+// counted when the matrix is built.
+//
+// Results go to one CSV (-o), one row per cell x repeat, fsync'ed as it is
+// written; its first line records the matrix hash and seed. Rerunning with
+// the same config resumes: finished rows are skipped, a torn last row is
+// cut off, the order stays that of the original seed. A changed config is
+// refused unless -f starts the file over. SIGINT stops after the current
+// cell. -n only prints the plan, -l stops after N cells.
+//
+// usage: ./matrix [-o matrix.csv] [-s seed] [-l max_cells] [-n] [-f] config
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <signal.h>
+#include <ctype.h>
+#include <time.h>
+#include <math.h>
+#include "bench.h"
+#include "arena.h"
+#include "chase.h"
+#include "walk.h"
+#include "copy_kernels.h"
+#include "rowprobe.h"
+
+#define MAX_AXIS    64
+#define MAX_BLOCKS  32
+#define MAX_CPUS    256
+#define MIN_SEC     0.1         // per read / copy measurement
+#define MIN_BATCH   10e-6       // read / copy passes between clock reads
+#define MIN_LOADS   (1L << 20)  // per chase measurement
+#define MAX_LOADS   (1L << 23)
+#define CONF_LINE   1024
+
+enum bench_kind { B_CHASE, B_READ, B_COPY, B_ABA, NBENCH };
+static const char *bench_name[NBENCH] = { "chase", "read", "copy", "aba" };
+static const char *bench_metric[NBENCH] = { "ns", "GBps", "GBps", "ns" };
+static const char *bench_default[NBENCH] = { "rand", "seq-fwd", "libc", "-" };
+
+struct block {
+    char name[32];
+    int bench[NBENCH], nbench;
+    size_t size[MAX_AXIS];
+    int nsize;
+    char pattern[MAX_AXIS][24];
+    int npattern;
+    int threads[MAX_AXIS], nthreads;
+    enum arena_backing pages[4];
+    int npages;
+    int cpu[MAX_AXIS], ncpu;
+    int repeat;
+};
+
+struct cell {
+    int block;
+    enum bench_kind bench;
+    size_t bytes;
+    const char *pattern;        // resolved: "-" only for aba
+    int threads;
+    enum arena_backing pages;
+    int cpu;                    // index into cpus[]
+};
+
+struct worker {
+    pthread_t th;
+    int cpu;
+    const struct cell *c;
+    pthread_barrier_t *ready;
+    double value;
+    int err;
+};
+
+static struct block blocks[MAX_BLOCKS];
+static int nblocks;
+static struct cell *cells;
+static size_t ncells;
+static int cpus[MAX_CPUS], ncpus;
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig) { (void)sig; stop = 1; }
+
+static uint64_t splitmix(uint64_t *s) {
+    uint64_t z = (*s += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t fnv(uint64_t h, const char *s) {
+    for (; *s; ++s) h = (h ^ (unsigned char)*s) * 0x100000001B3ULL;
+    return h;
+}
+
+static double wall_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static const char *fmt_bytes(size_t b, char *buf) {
+    static const char unit[] = "BKMG";
+    int u = 0;
+    while (u < 3 && b >= 1024 && b % 1024 == 0) { b /= 1024; ++u; }
+    sprintf(buf, u ? "%zu%c" : "%zu", b, unit[u]);
+    return buf;
+}
+
+static int parse_bytes(const char *s, size_t *out) {
+    char *end;
+    double v = strtod(s, &end);
+    switch (toupper((unsigned char)*end)) {
+    case 'G': v *= 1024; // fallthrough
+    case 'M': v *= 1024; // fallthrough
+    case 'K': v *= 1024; ++end; break;
+    }
+    if (end == s || *end || v < 1) return -1;
+    *out = (size_t)v;
+    return 0;
+}
+
+// ---------- config ----------
+
+// Splits a comma list in place; returns the count or -1 if more than max.
+static int split(char *s, char **tok, int max) {
+    int n = 0;
+    for (char *save = NULL, *t = strtok_r(s, ", \t", &save); t; t = strtok_r(NULL, ", \t", &save)) {
+        if (n == max) return -1;
+        tok[n++] = t;
+    }
+    return n;
+}
+
+static int parse_key(struct block *b, const char *key, char *val) {
+    char *tok[MAX_AXIS];
+    int n = split(val, tok, MAX_AXIS);
+    if (n < 1) return -1;
+    if (!strcmp(key, "bench")) {
+        for (int i = 0; i < n; ++i) {
+            int k = 0;
+            while (k < NBENCH && strcmp(tok[i], bench_name[k])) ++k;
+            if (k == NBENCH) { fprintf(stderr, "unknown bench '%s'\n", tok[i]); return -1; }
+            if (b->nbench == NBENCH) return -1;
+            b->bench[b->nbench++] = k;
+        }
+    } else if (!strcmp(key, "size")) {
+        b->nsize = 0;
+        for (int i = 0; i < n; ++i) {
+            char *dots = strstr(tok[i], "..");
+            size_t lo, hi;
+            if (dots) *dots = 0;
+            if (parse_bytes(tok[i], &lo) || (dots && parse_bytes(dots + 2, &hi))) {
+                fprintf(stderr, "bad size '%s'\n", tok[i]);
+                return -1;
+            }
+            if (!dots) hi = lo;
+            for (size_t s = lo; s <= hi; s *= 2) {
+                if (b->nsize == MAX_AXIS) { fprintf(stderr, "more than %d sizes\n", MAX_AXIS); return -1; }
+                b->size[b->nsize++] = s;
+            }
+        }
+    } else if (!strcmp(key, "pattern")) {
+        b->npattern = n;
+        for (int i = 0; i < n; ++i) snprintf(b->pattern[i], sizeof(b->pattern[i]), "%s", tok[i]);
+    } else if (!strcmp(key, "threads")) {
+        b->nthreads = n;
+        for (int i = 0; i < n; ++i) if ((b->threads[i] = atoi(tok[i])) < 1 || b->threads[i] > MAX_CPUS) return -1;
+    } else if (!strcmp(key, "pages")) {
+        if (n > 4) return -1;
+        b->npages = n;
+        for (int i = 0; i < n; ++i) if (arena_parse_backing(tok[i], &b->pages[i])) return -1;
+    } else if (!strcmp(key, "cpu")) {
+        b->ncpu = n;
+        for (int i = 0; i < n; ++i) b->cpu[i] = atoi(tok[i]);
+    } else if (!strcmp(key, "repeat")) {
+        if ((b->repeat = atoi(tok[0])) < 1) return -1;
+    } else {
+        fprintf(stderr, "unknown key '%s'\n", key);
+        return -1;
+    }
+    return 0;
+}
+
+// Reads the config into blocks[]; global lines before the first block go
+// into `global` and give the blocks their default repeat.
+static int read_config(const char *path, struct block *global, uint64_t *seed) {
+    FILE *f = fopen(path, "r");
+    if (!f) { perror(path); return -1; }
+    char line[CONF_LINE];
+    struct block *b = global;
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        ++lineno;
+        char *p = line, *hash = strchr(line, '#');
+        if (hash) *hash = 0;
+        while (isspace((unsigned char)*p)) ++p;
+        size_t len = strlen(p);
+        while (len && isspace((unsigned char)p[len - 1])) p[--len] = 0;
+        if (!*p) continue;
+        if (*p == '[') {
+            if (nblocks == MAX_BLOCKS || p[len - 1] != ']') goto bad;
+            b = &blocks[nblocks++];
+            memset(b, 0, sizeof(*b));
+            snprintf(b->name, sizeof(b->name), "%.*s", (int)(len - 2), p + 1);
+            continue;
+        }
+        char *val = p;
+        while (*val && !isspace((unsigned char)*val)) ++val;
+        if (*val) *val++ = 0;
+        if (b == global && !strcmp(p, "seed")) { *seed = strtoull(val, NULL, 0); continue; }
+        if (parse_key(b, p, val)) goto bad;
+    }
+    fclose(f);
+    return 0;
+bad:
+    fprintf(stderr, "%s:%d: cannot parse this line\n", path, lineno);
+    fclose(f);
+    return -1;
+}
+
+static int cpu_index(int cpu) {
+    for (int i = 0; i < ncpus; ++i) if (cpus[i] == cpu) return i;
+    return -1;
+}
+
+static copy_fn find_kernel(const char *name) {
+    for (int k = 0; k < n_copy_kernels; ++k)
+        if (!strcmp(name, copy_kernels[k].name)) return copy_kernels[k].fn;
+    return NULL;
+}
+
+// Whether `bench` can run `pattern` on `bytes` with `threads` threads.
+static int cell_ok(enum bench_kind bench, const char *pattern, size_t bytes, int threads) {
+    struct pattern p;
+    switch (bench) {
+    case B_CHASE:
+    case B_READ:
+        if (bytes < 2 * CACHELINE || bytes / CACHELINE > UINT32_MAX) return 0;
+        if (walk_parse(pattern, &p)) return 0;
+        return p.walk != W_TILE || bytes % ((size_t)TILE_PITCH * TILE_H) == 0;
+    case B_COPY:
+        return find_kernel(pattern) != NULL;
+    default:
+        return !strcmp(pattern, "-") && threads == 1 && bytes >= CACHELINE;
+    }
+}
+
+// Expands every block into cells; returns the number of units (cell x repeat).
+static size_t build(int default_repeat, size_t *dropped) {
+    static const char *dash = "-";
+    size_t cap = 0, units = 0;
+    *dropped = 0;
+    for (int bi = 0; bi < nblocks; ++bi) {
+        struct block *b = &blocks[bi];
+        if (!b->npattern) { b->npattern = 1; strcpy(b->pattern[0], dash); }
+        if (!b->nthreads) b->threads[b->nthreads++] = 1;
+        if (!b->npages) b->pages[b->npages++] = ARENA_THP;
+        if (!b->ncpu) b->cpu[b->ncpu++] = cpus[0];
+        if (!b->repeat) b->repeat = default_repeat;
+        if (!b->nbench || !b->nsize) {
+            fprintf(stderr, "[%s]: needs at least 'bench' and 'size'\n", b->name);
+            exit(1);
+        }
+        for (int i0 = 0; i0 < b->nbench; ++i0)
+        for (int i1 = 0; i1 < b->nsize; ++i1)
+        for (int i2 = 0; i2 < b->npattern; ++i2)
+        for (int i3 = 0; i3 < b->nthreads; ++i3)
+        for (int i4 = 0; i4 < b->npages; ++i4)
+        for (int i5 = 0; i5 < b->ncpu; ++i5) {
+            int ci = cpu_index(b->cpu[i5]);
+            const char *pat = strcmp(b->pattern[i2], dash) ? b->pattern[i2] : bench_default[b->bench[i0]];
+            if (ci < 0 || !cell_ok(b->bench[i0], pat, b->size[i1], b->threads[i3])) {
+                ++*dropped;
+                continue;
+            }
+            if (ncells == cap) {
+                cap = cap ? 2 * cap : 256;
+                cells = (struct cell *)realloc(cells, cap * sizeof(*cells));
+                if (!cells) { perror("realloc"); exit(1); }
+            }
+            cells[ncells++] = (struct cell){ bi, b->bench[i0], b->size[i1], pat,
+                                             b->threads[i3], b->pages[i4], ci };
+            units += (size_t)b->repeat;
+        }
+    }
+    return units;
+}
+
+// ---------- benchmarks ----------
+
+// Chains the n lines at base in the order of p (as patterns.c does); returns the head.
+static void **chase_prepare(char *base, size_t n, const struct pattern *p) {
+    uint32_t *idx = (uint32_t *)xalloc(CACHELINE, n * sizeof(uint32_t));
+    walk_fill(p, idx, n);
+    for (size_t i = 0; i < n; ++i)
+        *(void **)(base + (size_t)idx[i] * CACHELINE) = base + (size_t)idx[(i + 1) % n] * CACHELINE;
+    void **head = (void **)(base + (size_t)idx[0] * CACHELINE);
+    free(idx);
+    return head;
+}
+
+static double run_chase(void **head, size_t n) {
+    long loads = 2 * (long)n;
+    if (loads < MIN_LOADS) loads = MIN_LOADS;
+    if (loads > MAX_LOADS) loads = MAX_LOADS;
+    return chase_ns(head, loads);
+}
+
+// read and copy read the clock once per batch of passes, and double the
+// batch until it takes MIN_BATCH; otherwise small sizes time now_sec().
+static double run_read(const char *base, size_t n, const uint32_t *idx) {
+    uint64_t sum = walk_load_pass(base, idx, n);
+    long passes = 0, batch = 1;
+    double t0 = now_sec(), t1 = t0, last;
+    do {
+        for (long k = 0; k < batch; ++k) sum += walk_load_pass(base, idx, n);
+        passes += batch;
+        last = t1;
+        if ((t1 = now_sec()) - last < MIN_BATCH) batch *= 2;
+    } while (t1 - t0 < MIN_SEC);
+    asm volatile("" :: "r"(sum));
+    return (double)passes * (double)n * CACHELINE / (t1 - t0) / 1e9;
+}
+
+static double run_copy(char *dst, const char *src, size_t bytes, copy_fn fn) {
+    fn(dst, src, bytes);
+    long passes = 0, batch = 1;
+    double t0 = now_sec(), t1 = t0, last;
+    do {
+        for (long k = 0; k < batch; ++k) fn(dst, src, bytes);
+        passes += batch;
+        last = t1;
+        if ((t1 = now_sec()) - last < MIN_BATCH) batch *= 2;
+    } while (t1 - t0 < MIN_SEC);
+    asm volatile("" :: "r"(dst[0]) : "memory");
+    return (double)passes * (double)bytes / (t1 - t0) / 1e9;
+}
+
+static void *worker_run(void *arg) {
+    struct worker *w = (struct worker *)arg;
+    const struct cell *c = w->c;
+    if (pin_cpu(w->cpu)) fprintf(stderr, "warning: could not pin to cpu %d\n", w->cpu);
+
+    // the working set is exactly `bytes`; the arena rounds up to its page
+    size_t need = c->bench == B_COPY ? 2 * c->bytes : c->bench == B_ABA ? c->bytes + CACHELINE : c->bytes;
+    struct arena ar;
+    size_t lines = c->bytes / CACHELINE;
+    uint32_t *idx = NULL;
+    void **head = NULL;
+    struct pattern p;
+    w->err = arena_alloc(&ar, need, c->pages);
+    if (!w->err) {                      // all setup before the barrier
+        memset(ar.base, 0x5A, ar.bytes);
+        walk_parse(c->pattern, &p);
+        if (c->bench == B_READ) {
+            idx = (uint32_t *)xalloc(CACHELINE, lines * sizeof(uint32_t));
+            walk_fill(&p, idx, lines);
+        }
+        if (c->bench == B_CHASE) head = chase_prepare(ar.base, lines, &p);
+    }
+    pthread_barrier_wait(w->ready);     // all threads measure together
+    if (!w->err) {
+        switch (c->bench) {
+        case B_CHASE: w->value = run_chase(head, lines); break;
+        case B_READ:  w->value = run_read(ar.base, lines, idx); break;
+        case B_COPY:  w->value = run_copy(ar.base + c->bytes, ar.base, c->bytes, find_kernel(c->pattern)); break;
+        default:      w->value = ticks_ns((double)time_ABA(ar.base, ar.base + c->bytes)); break;
+        }
+        free(idx);
+        arena_free(&ar);
+    }
+    return NULL;
+}
+
+// Runs one cell; NAN if an arena could not be allocated.
+static double run_cell(const struct cell *c) {
+    static struct worker w[MAX_CPUS];
+    pthread_barrier_t ready;
+    pthread_barrier_init(&ready, NULL, (unsigned)c->threads);
+    for (int i = 0; i < c->threads; ++i) {
+        w[i] = (struct worker){ .cpu = cpus[(c->cpu + i) % ncpus], .c = c, .ready = &ready };
+        if (pthread_create(&w[i].th, NULL, worker_run, &w[i])) { perror("pthread_create"); exit(1); }
+    }
+    double sum = 0;
+    int err = 0;
+    for (int i = 0; i < c->threads; ++i) {
+        pthread_join(w[i].th, NULL);
+        sum += w[i].value;
+        err |= w[i].err;
+    }
+    pthread_barrier_destroy(&ready);
+    if (err) return NAN;
+    return c->bench == B_CHASE || c->bench == B_ABA ? sum / c->threads : sum;   // mean ns, total GB/s
+}
+
+// ---------- results file ----------
+
+// Opens `path` for appending. If it holds rows of the same matrix, marks
+// their units in `done`, takes the seed from it and cuts a torn last row.
+static FILE *open_results(const char *path, uint64_t hash, uint64_t *seed, int fresh,
+                          uint8_t *done, size_t nunits, size_t *ndone) {
+    char line[CONF_LINE];
+    *ndone = 0;
+    FILE *f = fresh ? NULL : fopen(path, "r+");
+    if (f) {
+        unsigned long long h = 0, s = 0;
+        if (!fgets(line, sizeof(line), f) || sscanf(line, "# matrix %llx seed %llu", &h, &s) != 2) {
+            fprintf(stderr, "%s exists and is not a matrix results file (-f to overwrite)\n", path);
+            exit(1);
+        }
+        if (h != hash) {
+            fprintf(stderr, "%s was written for a different matrix (-f to start over)\n", path);
+            exit(1);
+        }
+        *seed = s;
+        long good = ftell(f);
+        while (fgets(line, sizeof(line), f)) {
+            size_t len = strlen(line);
+            if (!len || line[len - 1] != '\n') break;           // torn row
+            good = ftell(f);
+            char *end;
+            unsigned long long id = strtoull(line, &end, 10);
+            if (end != line && *end == ',' && id < nunits && !done[id]) { done[id] = 1; ++*ndone; }
+        }
+        if (ftruncate(fileno(f), good)) { perror("ftruncate"); exit(1); }
+        fseek(f, good, SEEK_SET);
+        return f;
+    }
+    f = fopen(path, "w");
+    if (!f) { perror(path); exit(1); }
+    fprintf(f, "# matrix %016llx seed %llu\n", (unsigned long long)hash, (unsigned long long)*seed);
+    fprintf(f, "Id,Block,Bench,Bytes,Pattern,Threads,Pages,Cpu,Rep,Value,Metric,WallSec\n");
+    fflush(f);
+    return f;
+}
+
+int main(int ac, char **av) {
+    const char *out_path = "matrix.csv";
+    uint64_t seed = 1, cli_seed = 0;
+    int have_seed = 0, dry = 0, fresh = 0, opt;
+    long limit = -1;
+    while ((opt = getopt(ac, av, "o:s:l:nf")) != -1) {
+        switch (opt) {
+        case 'o': out_path = optarg; break;
+        case 's': cli_seed = strtoull(optarg, NULL, 0); have_seed = 1; break;
+        case 'l': limit = atol(optarg); break;
+        case 'n': dry = 1; break;
+        case 'f': fresh = 1; break;
+        default:  goto usage;
+        }
+    }
+    if (optind != ac - 1) goto usage;
+
+    ncpus = allowed_cpus(cpus, MAX_CPUS);
+    if (ncpus < 1) { cpus[0] = 0; ncpus = 1; }
+    copy_kernels_init();
+    static struct block global;
+    if (read_config(av[optind], &global, &seed)) return 1;
+    if (have_seed) seed = cli_seed;
+    if (!nblocks) { fprintf(stderr, "%s: no [blocks]\n", av[optind]); return 1; }
+    size_t dropped;
+    size_t nunits = build(global.repeat ? global.repeat : 3, &dropped);
+    if (!nunits) { fprintf(stderr, "the matrix has no runnable cells\n"); return 1; }
+
+    // unit u = (cell, rep) in config order; the hash covers every unit
+    size_t *unit_cell = (size_t *)malloc(nunits * sizeof(size_t));
+    int *unit_rep = (int *)malloc(nunits * sizeof(int));
+    uint8_t *done = (uint8_t *)calloc(nunits, 1);
+    size_t *order = (size_t *)malloc(nunits * sizeof(size_t));
+    if (!unit_cell || !unit_rep || !done || !order) { perror("malloc"); return 1; }
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    char desc[256], sz[32];
+    for (size_t c = 0, u = 0; c < ncells; ++c) {
+        const struct cell *cl = &cells[c];
+        snprintf(desc, sizeof(desc), "%s/%s/%zu/%s/%d/%s/%d/%d;", blocks[cl->block].name,
+                 bench_name[cl->bench], cl->bytes, cl->pattern, cl->threads,
+                 arena_backing_name[cl->pages], cpus[cl->cpu], blocks[cl->block].repeat);
+        hash = fnv(hash, desc);
+        for (int r = 0; r < blocks[cl->block].repeat; ++r, ++u) { unit_cell[u] = c; unit_rep[u] = r; }
+    }
+
+    size_t ndone = 0;
+    FILE *out = NULL;
+    if (!dry) {
+        out = open_results(out_path, hash, &seed, fresh, done, nunits, &ndone);
+        if (ndone && have_seed && cli_seed != seed)
+            fprintf(stderr, "resuming: keeping the file's seed %llu, -s ignored\n", (unsigned long long)seed);
+    }
+    uint64_t rng = seed;
+    for (size_t i = 0; i < nunits; ++i) order[i] = i;
+    for (size_t i = nunits - 1; i > 0; --i) {
+        size_t j = splitmix(&rng) % (i + 1), t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    printf("%d block(s), %zu cells (%zu combinations dropped), %zu runs, seed %llu; %zu already done\n",
+           nblocks, ncells, dropped, nunits, (unsigned long long)seed, ndone);
+    if (dry) {
+        for (int b = 0; b < nblocks; ++b) {
+            size_t n = 0;
+            for (size_t c = 0; c < ncells; ++c) n += cells[c].block == b;
+            printf("  [%s] %zu cells x %d\n", blocks[b].name, n, blocks[b].repeat);
+        }
+        return 0;
+    }
+
+    timer_init(1);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    long ran = 0;
+    for (size_t i = 0; i < nunits && !stop && ran != limit; ++i) {
+        size_t u = order[i];
+        if (done[u]) continue;
+        const struct cell *c = &cells[unit_cell[u]];
+        double v = run_cell(c);
+        if (isnan(v)) fprintf(stderr, "warning: no %s arena for this cell, recorded as nan\n",
+                            arena_backing_name[c->pages]);
+        fprintf(out, "%zu,%s,%s,%zu,%s,%d,%s,%d,%d,%.4f,%s,%.3f\n", u, blocks[c->block].name,
+                bench_name[c->bench], c->bytes, c->pattern, c->threads, arena_backing_name[c->pages],
+                cpus[c->cpu], unit_rep[u], v, bench_metric[c->bench], wall_sec());
+        fflush(out);
+        fsync(fileno(out));
+        done[u] = 1;
+        ++ndone;
+        ++ran;
+        printf("[%zu/%zu] %-10s %-5s %6s %-12s x%-2d %-3s cpu%-3d #%d  %10.3f %s\n", ndone, nunits,
+               blocks[c->block].name, bench_name[c->bench], fmt_bytes(c->bytes, sz), c->pattern,
+               c->threads, arena_backing_name[c->pages], cpus[c->cpu], unit_rep[u], v,
+               bench_metric[c->bench]);
+        fflush(stdout);
+    }
+    if (ndone < nunits)
+        printf("stopped with %zu of %zu runs done; run the same command again to resume\n", ndone, nunits);
+    printf("wrote %s\n", out_path);
+
+    fclose(out);
+    free(unit_cell);
+    free(unit_rep);
+    free(done);
+    free(order);
+    free(cells);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-o matrix.csv] [-s seed] [-l max_cells] [-n] [-f] config\n", av[0]);
+    return 1;
+}
@@ -0,0 +1,132 @@
+// memcpy_mt.c -- multi-threaded, core-pinned memcpy bandwidth scaling.
+//
+// For every size in exps[] and every thread count 1..N, N pinned threads
+// each copy between their own private, 64B-aligned src/dst pair. All
+// threads are released together from a barrier; we report per-thread GB/s
+// and the aggregate over the common wall-clock window, then the "knee"
+// (first thread count whose extra thread adds < 10% aggregate bandwidth).
+//
+// usage: ./memcpy_mt [-t max_threads] [-c cpu_list] [-m MiB_per_thread] [-o out.csv]
+//   -c takes e.g. "0-15" to restrict the curve to one socket; thread i is
+//      pinned to the i-th listed CPU. Defaults to every CPU we may run on.
+#include "bench.h"
+#include <unistd.h>
+
+#define MAX_THREADS 256
+#define KNEE_GAIN   1.10   // < 10% gain from one more thread => saturated
+
+struct worker {
+    pthread_t th;
+    int id, cpu;
+    size_t bytes;
+    long reps;
+    pthread_barrier_t *start;
+    double t0, t1;          // wall-clock copy window of this thread
+};
+
+static void *copy_worker(void *arg) {
+    struct worker *w = (struct worker *)arg;
+    if (pin_cpu(w->cpu)) fprintf(stderr, "warning: could not pin to cpu %d\n", w->cpu);
+
+    // Allocate after pinning so first-touch places pages near this core.
+    char *src = (char *)xalloc(CACHELINE, w->bytes);
+    char *dst = (char *)xalloc(CACHELINE, w->bytes);
+    memset(src, 0xA5, w->bytes);
+    memset(dst, 0, w->bytes);
+    prefault_touch(src, w->bytes);
+    prefault_touch(dst, w->bytes);
+    memcpy(dst, src, w->bytes);   // warm i-cache / TLB
+
+    pthread_barrier_wait(w->start);
+    w->t0 = now_sec();
+    for (long r = 0; r < w->reps; ++r) {
+        memcpy(dst, src, w->bytes);
+        asm volatile("" :: "r"(dst) : "memory");
+    }
+    w->t1 = now_sec();
+
+    free(src);
+    free(dst);
+    return NULL;
+}
+
+// Runs one (size, nthreads) cell; returns aggregate GB/s.
+static double run_cell(size_t bytes, int nthreads, const int *cpus, size_t per_thread,
+                       FILE *out) {
+    static struct worker w[MAX_THREADS];
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, (unsigned)nthreads);
+
+    long reps = (long)(per_thread / bytes);
+    if (reps < 8) reps = 8;
+
+    for (int i = 0; i < nthreads; ++i) {
+        w[i] = (struct worker){ .id = i, .cpu = cpus[i], .bytes = bytes,
+                                .reps = reps, .start = &start };
+        if (pthread_create(&w[i].th, NULL, copy_worker, &w[i])) {
+            perror("pthread_create"); exit(1);
+        }
+    }
+    for (int i = 0; i < nthreads; ++i) pthread_join(w[i].th, NULL);
+    pthread_barrier_destroy(&start);
+
+    double first = w[0].t0, last = w[0].t1, lo = 1e30, hi = 0;
+    for (int i = 0; i < nthreads; ++i) {
+        double gbps = (double)bytes * reps / (w[i].t1 - w[i].t0) / 1e9;
+        if (w[i].t0 < first) first = w[i].t0;
+        if (w[i].t1 > last)  last  = w[i].t1;
+        if (gbps < lo) lo = gbps;
+        if (gbps > hi) hi = gbps;
+        if (out) fprintf(out, "%zu,%d,%d,%d,%.3f\n", bytes, nthreads, i, w[i].cpu, gbps);
+    }
+    double agg = (double)bytes * reps * nthreads / (last - first) / 1e9;
+    if (out) fprintf(out, "%zu,%d,-1,-1,%.3f\n", bytes, nthreads, agg);
+    printf("%8zu B  %3d thr  aggregate %8.2f GB/s  per-thread %7.2f .. %7.2f GB/s\n",
+           bytes, nthreads, agg, lo, hi);
+    return agg;
+}
+
+int main(int ac, char **av) {
+    int cpus[MAX_THREADS];
+    int ncpus = allowed_cpus(cpus, MAX_THREADS);
+    int max_threads = ncpus;
+    size_t per_thread = (size_t)512 << 20;
+    const char *out_path = "scaling.csv";
+
+    int opt;
+    while ((opt = getopt(ac, av, "t:c:m:o:")) != -1) {
+        switch (opt) {
+        case 't': max_threads = atoi(optarg); break;
+        case 'c': ncpus = parse_cpu_list(optarg, cpus, MAX_THREADS); break;
+        case 'm': per_thread = (size_t)atol(optarg) << 20; break;
+        case 'o': out_path = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-t max_threads] [-c cpu_list] [-m MiB] [-o out.csv]\n", av[0]);
+            return 1;
+        }
+    }
+    if (max_threads > ncpus) max_threads = ncpus;
+    if (max_threads < 1) { fprintf(stderr, "no usable CPUs\n"); return 1; }
+
+    FILE *out = fopen(out_path, "w");
+    if (!out) { perror("fopen"); return 1; }
+    fprintf(out, "Size(Bytes),Threads,Thread,CPU,GBps\n");   // Thread=-1: aggregate
+
+    printf("memcpy scaling on %d CPUs (%d..%d), %zu MiB copied per thread per cell\n",
+           max_threads, cpus[0], cpus[max_threads - 1], per_thread >> 20);
+    printf("------------------------------\n");
+    for (int i = 0; i < NEXPS; ++i) {
+        size_t bytes = (size_t)1 << exps[i];
+        double agg[MAX_THREADS + 1] = {0};
+        int knee = 0;
+        for (int n = 1; n <= max_threads; ++n) {
+            agg[n] = run_cell(bytes, n, cpus, per_thread, out);
+            if (!knee && n > 1 && agg[n] < agg[n - 1] * KNEE_GAIN) knee = n - 1;
+        }
+        if (knee) printf("  knee at %d threads (%.2f GB/s)\n", knee, agg[knee]);
+        else      printf("  no knee up to %d threads (%.2f GB/s)\n", max_threads, agg[max_threads]);
+        printf("------------------------------\n");
+    }
+    fclose(out);
+    return 0;
+}
@@ -0,0 +1,109 @@
+// memcpy_zoo.c -- time every copy kernel in copy_kernels.h side by side.
+//
+// Same discipline as memtest() in hw1_test.c: 64B-aligned, pre-touched
+// buffers, WARMUP untimed copies, lfence+rdtscp around each copy. "cold"
+// flushes src and dst before every sample; "warm" copies the same pair
+// back to back so both stay cache-resident. For each size we keep the
+// median, then print which kernel wins each size band (crossover table).
+//
+// usage: ./memcpy_zoo [-o out.csv]
+#include "bench.h"
+#include "copy_kernels.h"
+#include <unistd.h>
+
+#ifndef REPEAT
+#define REPEAT 200
+#endif
+#define WARMUP 10
+
+enum { COLD, WARM, NMODES };
+static const char *mode_name[NMODES] = { "cold", "warm" };
+
+static uint64_t time_kernel(copy_fn fn, char *dst, char *src, size_t bytes, int mode) {
+    static uint64_t t[REPEAT];
+    for (int r = 0; r < WARMUP; ++r) fn(dst, src, bytes);
+    for (int r = 0; r < REPEAT; ++r) {
+        if (mode == COLD) {
+            clflush_range(src, bytes);
+            clflush_range(dst, bytes);
+        }
+        uint64_t t0 = tsc_begin();
+        fn(dst, src, bytes);
+        uint64_t t1 = tsc_end();
+        asm volatile("" :: "r"(dst[0]) : "memory");
+        t[r] = t1 - t0;
+    }
+    qsort(t, REPEAT, sizeof(uint64_t), cmp_u64);
+    return t[REPEAT / 2];
+}
+
+static void print_bands(int mode, uint64_t med[][MAX_KERNELS][NMODES]) {
+    printf("\n%s crossover bands:\n", mode_name[mode]);
+    int start = 0, prev = -1;
+    for (int i = 0; i <= NEXPS; ++i) {
+        int win = -1;
+        if (i < NEXPS) {
+            win = 0;
+            for (int k = 1; k < n_copy_kernels; ++k)
+                if (med[i][k][mode] < med[i][win][mode]) win = k;
+        }
+        if (i > 0 && win != prev) {
+            printf("  %8zu B .. %8zu B : %s\n", (size_t)1 << exps[start],
+                   (size_t)1 << exps[i - 1], copy_kernels[prev].name);
+            start = i;
+        }
+        prev = win;
+    }
+}
+
+int main(int ac, char **av) {
+    const char *out_path = "zoo.csv";
+    int opt;
+    while ((opt = getopt(ac, av, "o:")) != -1) {
+        if (opt == 'o') out_path = optarg;
+        else { fprintf(stderr, "usage: %s [-o out.csv]\n", av[0]); return 1; }
+    }
+
+    copy_kernels_init();
+    printf("CPU: sse2=%d avx2=%d avx512f=%d erms=%d fsrm=%d\n", cpu_feat.sse2,
+           cpu_feat.avx2, cpu_feat.avx512f, cpu_feat.erms, cpu_feat.fsrm);
+
+    FILE *out = fopen(out_path, "w");
+    if (!out) { perror("fopen"); return 1; }
+    fprintf(out, "Size(Bytes),Kernel,Mode,MedianTicks\n");
+
+    size_t max_bytes = (size_t)1 << exps[NEXPS - 1];
+    char *src = (char *)xalloc(CACHELINE, max_bytes);
+    char *dst = (char *)xalloc(CACHELINE, max_bytes);
+    memset(src, 0xA5, max_bytes);
+    memset(dst, 0, max_bytes);
+    prefault_touch(src, max_bytes);
+    prefault_touch(dst, max_bytes);
+
+    static uint64_t med[NEXPS][MAX_KERNELS][NMODES];
+    for (int m = 0; m < NMODES; ++m) {
+        printf("\nmedian ticks, %s (* = winner)\n%10s", mode_name[m], "size");
+        for (int k = 0; k < n_copy_kernels; ++k) printf(" %11s", copy_kernels[k].name);
+        printf("\n");
+        for (int i = 0; i < NEXPS; ++i) {
+            size_t bytes = (size_t)1 << exps[i];
+            int win = 0;
+            for (int k = 0; k < n_copy_kernels; ++k) {
+                med[i][k][m] = time_kernel(copy_kernels[k].fn, dst, src, bytes, m);
+                if (med[i][k][m] < med[i][win][m]) win = k;
+                fprintf(out, "%zu,%s,%s,%" PRIu64 "\n", bytes, copy_kernels[k].name,
+                        mode_name[m], med[i][k][m]);
+            }
+            printf("%10zu", bytes);
+            for (int k = 0; k < n_copy_kernels; ++k)
+                printf(" %10" PRIu64 "%c", med[i][k][m], k == win ? '*' : ' ');
+            printf("\n");
+        }
+    }
+    for (int m = 0; m < NMODES; ++m) print_bands(m, med);
+
+    free(src);
+    free(dst);
+    fclose(out);
+    return 0;
+}
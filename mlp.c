@@ -0,0 +1,179 @@
+// mlp.c -- memory-level parallelism: K independent misses in flight.
+//
+// row_total.c and latency.c time one miss at a time on purpose. Here one
+// core walks K independent random chains (chase.h) in lock step over an
+// arena much larger than the LLC, so up to K demand misses can be
+// outstanding at once. For K = 1..-K we report
+//   latency:   ns per step of one chain (how long each miss now takes),
+//   bandwidth: K lines per step,
+//   loaded:    ns per load of a probe chain walked on a second CPU while
+//              the K chains run (the walk core's own loads cannot be timed
+//              without draining its misses), i.e. the memory latency its
+//              misses see under their own load;
+//   in flight: bandwidth x loaded latency / 64 B (Little's law), i.e.
+//              K x loaded / (ns per step): how many misses the core
+//              actually kept outstanding. With one CPU there is no probe
+//              and the unloaded latency stands in, which undercounts once
+//              the misses queue.
+// Bandwidth stops growing once the L1 fill buffers (or, for L2 misses
+// that queue further out, the L2 super queue) are full; the first K
+// within SAT_FRAC of the peak is reported as the saturation point.
+//
+// usage: ./mlp [-K max_chains] [-M arena_MiB] [-p 4k|thp|2m|1g] [-c cpu] [-o mlp.csv]
+#define _GNU_SOURCE
+#include <unistd.h>
+#include "bench.h"
+#include "arena.h"
+#include "chase.h"
+
+#define MAX_K     64
+#define LOADS     (1L << 23)    // total dependent loads per K
+#define SAT_FRAC  0.95          // bandwidth within 5% of peak => saturated
+#define PROBE_LOADS 4096        // probe chain loads per timed batch
+
+struct probe {
+    pthread_t th;
+    int cpu;
+    void **head;
+    volatile int on, idle, stop;
+    double sec;                 // accumulated over batches that ran while `on`
+    long loads;
+};
+
+// Walks the probe chain in batches; a batch counts only if the walk was
+// running at both ends. Sets `idle` after each batch that saw `on` clear.
+static void *probe_run(void *arg) {
+    struct probe *pr = (struct probe *)arg;
+    if (pin_cpu(pr->cpu)) fprintf(stderr, "warning: could not pin probe to cpu %d\n", pr->cpu);
+    void **p = pr->head;
+    while (!__atomic_load_n(&pr->stop, __ATOMIC_RELAXED)) {
+        int on = __atomic_load_n(&pr->on, __ATOMIC_ACQUIRE);
+        double t0 = now_sec();
+        for (long i = 0; i < PROBE_LOADS; ++i) p = (void **)*p;
+        double t1 = now_sec();
+        if (on && __atomic_load_n(&pr->on, __ATOMIC_ACQUIRE)) {
+            pr->sec += t1 - t0;
+            pr->loads += PROBE_LOADS;
+        } else if (!on) {
+            __atomic_store_n(&pr->idle, 1, __ATOMIC_RELEASE);
+        }
+    }
+    asm volatile("" :: "r"(p));
+    return NULL;
+}
+
+// Walks K chains `steps` times each; returns wall seconds.
+static double walk(void **const *head, int K, long steps) {
+    void **p[MAX_K];
+    for (int k = 0; k < K; ++k) p[k] = head[k];
+    for (long s = 0; s < steps / 16; ++s)            // warm TLB / path
+        for (int k = 0; k < K; ++k) p[k] = (void **)*p[k];
+    double t0 = now_sec();
+    for (long s = 0; s < steps; ++s)
+        for (int k = 0; k < K; ++k) p[k] = (void **)*p[k];
+    double t1 = now_sec();
+    for (int k = 0; k < K; ++k) asm volatile("" :: "r"(p[k]));
+    return t1 - t0;
+}
+
+int main(int ac, char **av) {
+    int max_k = 32, cpu = -1;
+    size_t arena_mb = 1024;
+    enum arena_backing backing = ARENA_THP;
+    const char *out_path = "mlp.csv";
+    int opt;
+    while ((opt = getopt(ac, av, "K:M:p:c:o:")) != -1) {
+        switch (opt) {
+        case 'K': max_k = atoi(optarg); break;
+        case 'M': arena_mb = (size_t)atol(optarg); break;
+        case 'p': if (arena_parse_backing(optarg, &backing)) goto usage; break;
+        case 'c': cpu = atoi(optarg); break;
+        case 'o': out_path = optarg; break;
+        default:  goto usage;
+        }
+    }
+    if (max_k < 1 || max_k > MAX_K) goto usage;
+    int cpus[MAX_K];
+    int ncpus = allowed_cpus(cpus, MAX_K);
+    if (cpu < 0) cpu = ncpus ? cpus[0] : 0;
+    if (pin_cpu(cpu)) fprintf(stderr, "warning: could not pin to cpu %d\n", cpu);
+
+    struct arena ar, par;
+    if (arena_alloc(&ar, arena_mb << 20, backing)) return 1;
+    size_t lines = ar.bytes / CACHELINE;
+    uint32_t *perm = (uint32_t *)xalloc(CACHELINE, lines * sizeof(uint32_t));
+
+    // loaded-latency probe on the first other allowed CPU, own arena
+    static struct probe pr;
+    pr.cpu = -1;
+    for (int i = 0; i < ncpus && pr.cpu < 0; ++i)
+        if (cpus[i] != cpu) pr.cpu = cpus[i];
+    if (pr.cpu >= 0) {
+        if (arena_alloc(&par, ar.bytes / 4, backing)) return 1;
+        pr.head = chase_link(par.base, CACHELINE, par.bytes / CACHELINE, perm);
+        if (pthread_create(&pr.th, NULL, probe_run, &pr)) { perror("pthread_create"); return 1; }
+        printf("loaded latency: probe chain on cpu %d\n", pr.cpu);
+    } else {
+        fprintf(stderr, "only one CPU: no probe, in flight uses the unloaded latency (a lower bound)\n");
+    }
+    FILE *out = fopen(out_path, "w");
+    if (!out) { perror(out_path); return 1; }
+    fprintf(out, "Chains,LatencyNs,GBps,LoadedNs,InFlight\n");
+    printf("arena %zu MiB (%s pages), %ld loads per point\n",
+           ar.bytes >> 20, arena_backing_name[ar.kind], LOADS);
+    printf("%6s %12s %10s %10s %10s\n", "chains", "ns/step", "GB/s", "loaded ns", "in flight");
+
+    static double gbps[MAX_K + 1], inflight[MAX_K + 1];
+    double lat1 = 0, peak = 0;
+    for (int K = 1; K <= max_k; ++K) {
+        // K disjoint slices of the arena, one random chain each
+        size_t per = lines / (size_t)K;
+        void **head[MAX_K];
+        for (int k = 0; k < K; ++k)
+            head[k] = chase_link(ar.base + (size_t)k * per * CACHELINE, CACHELINE, per, perm);
+
+        long steps = LOADS / K;
+        pr.sec = 0;
+        pr.loads = 0;
+        __atomic_store_n(&pr.on, 1, __ATOMIC_RELEASE);
+        double sec = walk(head, K, steps);
+        __atomic_store_n(&pr.idle, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&pr.on, 0, __ATOMIC_RELEASE);
+        while (pr.cpu >= 0 && !__atomic_load_n(&pr.idle, __ATOMIC_ACQUIRE)) _mm_pause();
+        double ns = sec * 1e9 / (double)steps;
+        gbps[K] = (double)K * (double)steps * CACHELINE / sec / 1e9;
+        if (K == 1) lat1 = ns;
+        double loaded = pr.loads ? pr.sec * 1e9 / (double)pr.loads : lat1;
+        inflight[K] = (double)K * loaded / ns;          // = GB/s * loaded ns / 64 B
+        if (gbps[K] > peak) peak = gbps[K];
+        printf("%6d %12.1f %10.2f %10.1f %10.1f\n", K, ns, gbps[K], loaded, inflight[K]);
+        fprintf(out, "%d,%.2f,%.3f,%.2f,%.2f\n", K, ns, gbps[K], loaded, inflight[K]);
+        fflush(stdout);
+    }
+
+    int sat = max_k;
+    for (int K = 1; K <= max_k; ++K)
+        if (gbps[K] >= SAT_FRAC * peak) { sat = K; break; }
+    printf("\nunloaded latency %.1f ns; peak %.2f GB/s\n", lat1, peak);
+    if (sat < max_k)
+        printf("saturates at ~%d chains (%.1f misses in flight by Little's law)\n",
+               sat, inflight[sat]);
+    else
+        printf("still scaling at %d chains; rerun with a larger -K\n", max_k);
+    printf("wrote %s\n", out_path);
+
+    if (pr.cpu >= 0) {
+        __atomic_store_n(&pr.stop, 1, __ATOMIC_RELAXED);
+        pthread_join(pr.th, NULL);
+        arena_free(&par);
+    }
+    fclose(out);
+    free(perm);
+    arena_free(&ar);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-K max_chains] [-M arena_MiB] [-p 4k|thp|2m|1g] [-c cpu] "
+                    "[-o mlp.csv]\n", av[0]);
+    return 1;
+}
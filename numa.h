@@ -0,0 +1,113 @@
+// numa.h -- explicit CPU and memory node placement.
+//
+// Without a policy every buffer lands wherever first touch happened to
+// run, so on a multi-socket box memtest and the row probes measure a mix
+// of local and remote memory. These wrappers call the mbind /
+// set_mempolicy / get_mempolicy system calls directly (no libnuma) and
+// read the topology from /sys/devices/system/node. On a kernel or machine
+// without NUMA they report a single node 0 holding every CPU, binding to
+// it succeeds trivially, and a failed syscall only prints a warning.
+//
+//   --cpu-node N   run on node N's CPUs        (numa_bind_cpu)
+//   --mem-node N   allocate from node N only   (numa_set_mem / numa_mbind)
+#ifndef NUMA_H
+#define NUMA_H
+
+#include "bench.h"
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#define NUMA_MAX_NODES 64
+#define NUMA_SYSFS     "/sys/devices/system/node"
+
+// Number of nodes (highest present nodeN + 1), at least 1.
+static inline int numa_num_nodes(void) {
+    int n = 0;
+    for (int i = 0; i < NUMA_MAX_NODES; ++i) {
+        char path[96];
+        snprintf(path, sizeof(path), NUMA_SYSFS "/node%d", i);
+        if (access(path, F_OK) == 0) n = i + 1;
+    }
+    return n ? n : 1;
+}
+
+// CPUs of `node` (all allowed CPUs if the topology is not exported).
+static inline int numa_node_cpus(int node, int *cpus, int max) {
+    char path[96], buf[4096];
+    snprintf(path, sizeof(path), NUMA_SYSFS "/node%d/cpulist", node);
+    FILE *f = fopen(path, "r");
+    if (!f) return node == 0 ? allowed_cpus(cpus, max) : 0;
+    int n = fgets(buf, sizeof(buf), f) ? parse_cpu_list(buf, cpus, max) : 0;
+    fclose(f);
+    return n;
+}
+
+// Restricts the calling thread to `node`'s CPUs. 0 on success.
+static inline int numa_bind_cpu(int node) {
+    int cpus[CPU_SETSIZE];
+    int n = numa_node_cpus(node, cpus, CPU_SETSIZE);
+    if (n <= 0) { fprintf(stderr, "numa: node %d has no CPUs\n", node); return -1; }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = 0; i < n; ++i) CPU_SET(cpus[i], &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) {
+        perror("numa: pthread_setaffinity_np");
+        return -1;
+    }
+    return 0;
+}
+
+// Binds future allocations of the calling thread to `node`. 0 on success.
+static inline int numa_set_mem(int node) {
+    unsigned long mask = 1UL << node;
+    if (syscall(SYS_set_mempolicy, MPOL_BIND, &mask, sizeof(mask) * 8)) {
+        fprintf(stderr, "numa: set_mempolicy(node %d): %s\n", node, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// Binds [addr, addr+len) to `node`, migrating pages already touched.
+static inline int numa_mbind(void *addr, size_t len, int node) {
+    unsigned long mask = 1UL << node;
+    if (syscall(SYS_mbind, addr, len, MPOL_BIND, &mask, sizeof(mask) * 8,
+                MPOL_MF_STRICT | MPOL_MF_MOVE)) {
+        fprintf(stderr, "numa: mbind(node %d): %s\n", node, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// Node holding the (touched) page at `p`, or -1.
+static inline int numa_node_of(const void *p) {
+    int node = -1;
+    if (syscall(SYS_get_mempolicy, &node, NULL, 0, p, MPOL_F_NODE | MPOL_F_ADDR)) return -1;
+    return node;
+}
+
+// Parses the shared options; returns 1 if av[*i] was consumed.
+static inline int numa_parse_arg(int *cpu_node, int *mem_node, int ac, char **av, int *i) {
+    if (*i + 1 >= ac) return 0;
+    if (!strcmp(av[*i], "--cpu-node"))      *cpu_node = atoi(av[++*i]);
+    else if (!strcmp(av[*i], "--mem-node")) *mem_node = atoi(av[++*i]);
+    else return 0;
+    return 1;
+}
+
+// Applies --cpu-node / --mem-node (-1 = leave alone) to the calling
+// thread before anything is allocated. Exits on an out-of-range node.
+static inline void numa_apply(int cpu_node, int mem_node) {
+    int nodes = numa_num_nodes();
+    if (cpu_node >= nodes || mem_node >= nodes) {
+        fprintf(stderr, "numa: only %d node(s)\n", nodes);
+        exit(1);
+    }
+    if (cpu_node >= 0) numa_bind_cpu(cpu_node);
+    if (mem_node >= 0) numa_set_mem(mem_node);
+    if (cpu_node >= 0 || mem_node >= 0)
+        printf("numa: %d node(s); cpu node %d, mem node %d\n", nodes, cpu_node, mem_node);
+}
+
+#endif // NUMA_H
@@ -0,0 +1,121 @@
+// numa_matrix.c -- node-by-node latency and bandwidth matrix.
+//
+// For every (CPU node, memory node) pair the thread is bound to the CPU
+// node's cores (numa_bind_cpu) and its buffers to the memory node
+// (arena_alloc_node -> mbind, checked with get_mempolicy), then we measure
+//   latency:   random pointer chase (chase.h) over -M MiB, ns per load;
+//   bandwidth: memcpy between two -B MiB buffers on the memory node, GB/s.
+// The diagonal is local memory; off-diagonal cells are remote. On a
+// single-node machine the matrix is 1x1 -- the binding path still runs, so
+// the tool can be tested anywhere.
+//
+// usage: ./numa_matrix [-M chase_MiB] [-B copy_MiB] [-p 4k|thp|2m|1g] [-o numa.csv]
+#define _GNU_SOURCE
+#include <unistd.h>
+#include "bench.h"
+#include "arena.h"
+#include "chase.h"
+#include "numa.h"
+
+#define CHASE_LOADS (1L << 23)
+#define COPY_SEC    0.2
+
+// Arena bound to `node`; warns if the pages did not land there.
+static int alloc_on(struct arena *a, size_t bytes, enum arena_backing kind, int node) {
+    if (arena_alloc_node(a, bytes, kind, node)) return -1;
+    int got = numa_node_of(a->base);
+    if (got >= 0 && got != node)
+        fprintf(stderr, "warning: asked for node %d, pages are on node %d\n", node, got);
+    return 0;
+}
+
+static double latency_cell(int node, size_t bytes, enum arena_backing kind, uint32_t *perm) {
+    struct arena ar;
+    if (alloc_on(&ar, bytes, kind, node)) exit(1);
+    double ns = chase_ns(chase_link(ar.base, CACHELINE, ar.bytes / CACHELINE, perm), CHASE_LOADS);
+    arena_free(&ar);
+    return ns;
+}
+
+static double bandwidth_cell(int node, size_t bytes, enum arena_backing kind) {
+    struct arena src, dst;
+    if (alloc_on(&src, bytes, kind, node) || alloc_on(&dst, bytes, kind, node)) exit(1);
+    memcpy(dst.base, src.base, bytes);                  // warm TLB / path
+    long reps = 0;
+    double t0 = now_sec(), t1;
+    do {
+        memcpy(dst.base, src.base, bytes);
+        asm volatile("" :: "r"(dst.base) : "memory");
+        ++reps;
+    } while ((t1 = now_sec()) - t0 < COPY_SEC);
+    arena_free(&src);
+    arena_free(&dst);
+    return (double)bytes * reps / (t1 - t0) / 1e9;
+}
+
+static void print_matrix(const char *title, const char *unit, int n, double m[][NUMA_MAX_NODES],
+                         const int *has_cpu) {
+    printf("\n%s (%s), rows = CPU node, columns = memory node\n      ", title, unit);
+    for (int j = 0; j < n; ++j) printf("  mem%-4d", j);
+    printf("\n");
+    for (int i = 0; i < n; ++i) {
+        if (!has_cpu[i]) continue;
+        printf("cpu%-3d", i);
+        for (int j = 0; j < n; ++j) printf(" %8.2f", m[i][j]);
+        printf("\n");
+    }
+}
+
+int main(int ac, char **av) {
+    size_t chase_mb = 256, copy_mb = 64;
+    enum arena_backing backing = ARENA_THP;
+    const char *out_path = "numa.csv";
+    int opt;
+    while ((opt = getopt(ac, av, "M:B:p:o:")) != -1) {
+        switch (opt) {
+        case 'M': chase_mb = (size_t)atol(optarg); break;
+        case 'B': copy_mb = (size_t)atol(optarg); break;
+        case 'p': if (arena_parse_backing(optarg, &backing)) goto usage; break;
+        case 'o': out_path = optarg; break;
+        default:  goto usage;
+        }
+    }
+
+    int n = numa_num_nodes();
+    static int has_cpu[NUMA_MAX_NODES];
+    static double lat[NUMA_MAX_NODES][NUMA_MAX_NODES], bw[NUMA_MAX_NODES][NUMA_MAX_NODES];
+    int cpus[CPU_SETSIZE];
+    printf("%d NUMA node(s):", n);
+    for (int i = 0; i < n; ++i) {
+        has_cpu[i] = numa_node_cpus(i, cpus, CPU_SETSIZE) > 0;
+        printf(" node%d%s", i, has_cpu[i] ? "" : "(no CPUs)");
+    }
+    printf("\n");
+
+    uint32_t *perm = (uint32_t *)xalloc(CACHELINE, ((chase_mb << 20) / CACHELINE) * sizeof(uint32_t));
+    FILE *out = fopen(out_path, "w");
+    if (!out) { perror(out_path); return 1; }
+    fprintf(out, "CpuNode,MemNode,LatencyNs,CopyGBps\n");
+
+    for (int c = 0; c < n; ++c) {
+        if (!has_cpu[c] || numa_bind_cpu(c)) continue;
+        for (int m = 0; m < n; ++m) {
+            lat[c][m] = latency_cell(m, chase_mb << 20, backing, perm);
+            bw[c][m] = bandwidth_cell(m, copy_mb << 20, backing);
+            printf("  cpu node %d -> mem node %d: %7.1f ns  %7.2f GB/s\n", c, m, lat[c][m], bw[c][m]);
+            fprintf(out, "%d,%d,%.2f,%.3f\n", c, m, lat[c][m], bw[c][m]);
+            fflush(stdout);
+        }
+    }
+    print_matrix("pointer-chase latency", "ns", n, lat, has_cpu);
+    print_matrix("memcpy bandwidth", "GB/s", n, bw, has_cpu);
+    printf("wrote %s\n", out_path);
+
+    fclose(out);
+    free(perm);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-M chase_MiB] [-B copy_MiB] [-p 4k|thp|2m|1g] [-o numa.csv]\n", av[0]);
+    return 1;
+}
@@ -4,109 +4,187 @@
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
-#include <x86intrin.h>   // _mm_clflush, _mm_lfence, _mm_mfence, __rdtscp
+#include <unistd.h>
+#include <getopt.h>
 
 // --------- Tunables (keep small & simple) ----------
 #define ARENA_MB   256          // arena size to sample addresses from
-#define CACHELINE  64
-#define PAGE       4096
-#define WARMUP     10
 #define TRIALS     200          // per A->B->A timing
 #define SCAN_STRIDE (64*1024)   // step when scanning B candidates (64 KiB)
-
-// ---------- Helpers you already used ----------
-static inline void clflush_range(void *p, size_t len) {
-    uintptr_t a = (uintptr_t)p & ~(uintptr_t)(CACHELINE - 1);
-    uintptr_t e = (uintptr_t)p + len;
-    for (; a < e; a += CACHELINE) _mm_clflush((void*)a);
-    _mm_mfence(); // ensure flush completes
-}
-
-static inline uint64_t tsc_now(void) {
-    unsigned aux;
-    _mm_lfence();
-    uint64_t t = __rdtscp(&aux);
-    _mm_lfence();
-    return t;
+#define HIT_DELTA  512          // physical column offset used for the row-hit pair
+#define GAP_FIRST_NS 25.0       // idle-gap sweep: first non-zero gap
+#define GAP_STEP     1.4142     // ... then half-octave steps
+#define TREFI_NS     7800.0     // DDR4/5 refresh interval at normal temperature
+
+#include "arena.h"
+#include "rowprobe.h"           // time_ABA() and the flush/TSC helpers
+#include "timer.h"
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-p 4k|thp|2m|1g] [-c conflict_delta] [-n noconflict_delta] [-g max_us]\n"
+            "          [--cpu-node N] [--mem-node N]\n"
+            "  -c/-n reuse physical deltas (bytes) printed by an earlier scan and skip it\n"
+            "  -g    also sweep an idle gap of 0..max_us between the two same-row accesses\n",
+            prog);
 }
 
-static inline void prefault_touch(char *buf, size_t bytes) {
-    for (size_t i = 0; i < bytes; i += PAGE) buf[i] = (char)(i);
-    if (bytes) buf[bytes-1] ^= 0; // touch tail
+static void print_pa(const char *tag, const struct arena *ar, const char *p) {
+    uint64_t pa = arena_pa(ar, p);
+    if (pa == ARENA_PA_NONE) printf("  %-6s va=%p  pa=?\n", tag, (void*)p);
+    else printf("  %-6s va=%p  pa=0x%" PRIx64 "\n", tag, (void*)p, pa);
 }
 
-static int cmp_u64(const void *a, const void *b) {
-    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
-    return (x > y) - (x < y);
+// Per-sample counter means of the last time_ABA() call, if any are open.
+static void print_ctr(const char *tag, const double *c) {
+    if (!aba_pmu || !aba_pmu->n) return;
+    printf("    %-12s", tag);
+    for (int i = 0; i < aba_pmu->n; ++i) printf(" %s=%.2f", aba_pmu->name[i], c[i]);
+    printf("\n");
 }
 
-// Measure Δ for A->B->A (loads) with flushes to force DRAM behavior.
-static uint64_t time_ABA(char *A, char *B) {
-    uint64_t t[TRIALS];
-
-    // Warmup
-    for (int i = 0; i < WARMUP; ++i) {
-        clflush_range(A, CACHELINE);
-        clflush_range(B, CACHELINE);
-        (void)*(volatile char*)A;
-        (void)*(volatile char*)B;
-        (void)*(volatile char*)A;
+// Row-hit latency of A->(idle)->C against the gap, and the gap at which it
+// climbs halfway from the zero-gap hit to the long-gap plateau: the
+// controller's page-close timeout, if it has one.
+static void gap_sweep(const char *A, const char *C, double max_ns) {
+    double gap[64];
+    uint64_t med[64];
+    int n = 0;
+    printf("\nIdle-gap sweep (A, idle, then C in the same row):\n");
+    for (double g = 0; g <= max_ns && n < 64; g = g ? g * GAP_STEP : GAP_FIRST_NS) {
+        gap[n] = g;
+        med[n] = time_gap(A, C, g);
+        printf("  gap %9.0f ns  %6" PRIu64 " ticks  %7.1f ns\n", g, med[n], ticks_ns((double)med[n]));
+        ++n;
     }
-
-    for (int r = 0; r < TRIALS; ++r) {
-        clflush_range(A, CACHELINE);
-        clflush_range(B, CACHELINE);
-        uint64_t t0 = tsc_now();
-        // Three dependent-ish loads (prevent reordering via volatile)
-        volatile char x;
-        x = *A;
-        x = *B;
-        x = *A;
-        (void)x;
-        uint64_t t1 = tsc_now();
-        t[r] = t1 - t0;
+    if (n < 4) return;
+    uint64_t hit = med[0];
+    uint64_t tail[3] = { med[n - 3], med[n - 2], med[n - 1] };
+    qsort(tail, 3, sizeof(uint64_t), cmp_u64);
+    uint64_t far = tail[1];
+    if (far < hit + hit / 10) {
+        printf("  flat up to %.0f ns: rows stay open at least that long (open-page, or a longer timeout)\n",
+               max_ns);
+        return;
     }
-    qsort(t, TRIALS, sizeof(uint64_t), cmp_u64);
-    return t[TRIALS/2]; // median
+    int k = 1;
+    while (k < n && med[k] < (hit + far) / 2) ++k;
+    if (k == 1)
+        printf("  rises at the first gap: row closes almost immediately (close-page policy)\n");
+    else
+        printf("  page-close timeout between %.0f and %.0f ns (hit %" PRIu64 " -> %" PRIu64 " ticks)\n",
+               gap[k - 1], gap[k < n ? k : n - 1], hit, far);
+    if (k < n && gap[k] >= TREFI_NS / 2)
+        printf("  (near tREFI=%.0f ns: may be refresh closing the row rather than a timer)\n", TREFI_NS);
 }
 
-int main(void) {
+int main(int ac, char **av) {
+    enum arena_backing backing = ARENA_THP;
+    long long conf_delta = 0, noconf_delta = 0;   // 0 = scan for it
+    double gap_max_us = 0;                          // 0 = no idle-gap sweep
+    int cpu_node = -1, mem_node = -1;               // numa.h, -1 = unbound
+    static const struct option longopts[] = {
+        { "cpu-node", required_argument, NULL, 'C' },
+        { "mem-node", required_argument, NULL, 'N' },
+        { 0, 0, 0, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(ac, av, "p:c:n:g:", longopts, NULL)) != -1) {
+        switch (opt) {
+        case 'C': cpu_node = atoi(optarg); break;
+        case 'N': mem_node = atoi(optarg); break;
+        case 'g': gap_max_us = atof(optarg); break;
+        case 'p': if (arena_parse_backing(optarg, &backing)) { usage(av[0]); return 1; } break;
+        case 'c': conf_delta = strtoll(optarg, NULL, 0); break;
+        case 'n': noconf_delta = strtoll(optarg, NULL, 0); break;
+        default: usage(av[0]); return 1;
+        }
+    }
+
+    numa_apply(cpu_node, -1);
+    timer_init(1);              // time_ABA() now reports net ticks
     size_t arena_bytes = (size_t)ARENA_MB << 20;
-    // 64B-aligned arena
-    char *arena = NULL;
-    if (posix_memalign((void**)&arena, CACHELINE, arena_bytes)) {
-        perror("posix_memalign"); return 1;
+    struct arena ar;
+    if (arena_alloc_node(&ar, arena_bytes, backing, mem_node)) {
+        fprintf(stderr, "%s backing unavailable, falling back to 4k\n",
+                arena_backing_name[backing]);
+        if (arena_alloc_node(&ar, arena_bytes, ARENA_4K, mem_node)) return 1;
     }
+    if (mem_node >= 0) printf("arena on node %d (asked %d)\n", numa_node_of(ar.base), mem_node);
+    static struct pmu pmu;      // counters per A->B->A sample, where available
+    if (pmu_open(&pmu, 1)) aba_pmu = &pmu;
+    char *arena = ar.base;
+    arena_bytes = ar.bytes;
     memset(arena, 0xA5, arena_bytes);
-    prefault_touch(arena, arena_bytes);
+    printf("Arena: %zu MiB, %s pages, physical addresses %s\n", arena_bytes >> 20,
+           arena_backing_name[ar.kind], arena_has_pa(&ar) ? "visible" : "hidden (not root?)");
 
     // Pick a base A (start of arena is fine for this minimal probe)
     char *A = arena;
+    uint64_t pa_A = arena_pa(&ar, A);
 
     // Scan candidate B addresses to find min and max median Δ
     uint64_t best_min = UINT64_MAX, best_max = 0;
     char *B_min = NULL, *B_max = NULL;
 
-    for (size_t off = SCAN_STRIDE; off + CACHELINE < arena_bytes; off += SCAN_STRIDE) {
-        char *B = arena + off;
-        uint64_t med = time_ABA(A, B);
-        if (med < best_min) { best_min = med; B_min = B; }
-        if (med > best_max) { best_max = med; B_max = B; }
+    if (conf_delta && noconf_delta) {
+        // Known physical deltas from an earlier run: no rescan needed.
+        B_max = arena_partner(&ar, A, conf_delta);
+        B_min = arena_partner(&ar, A, noconf_delta);
+        if (!B_max || !B_min) {
+            fprintf(stderr, "delta not inside this arena's physical range; "
+                            "use a hugepage backing or rescan\n");
+            return 1;
+        }
+        best_max = time_ABA(A, B_max);
+        best_min = time_ABA(A, B_min);
+    } else {
+        for (size_t off = SCAN_STRIDE; off + CACHELINE < arena_bytes; off += SCAN_STRIDE) {
+            char *B = arena + off;
+            uint64_t med = time_ABA(A, B);
+            if (med < best_min) { best_min = med; B_min = B; }
+            if (med > best_max) { best_max = med; B_max = B; }
+        }
     }
 
-    // Choose a same-row candidate C as a small offset from A.
-    // (Typical DDR4 row buffer is on the order of KBs; small column offsets
-    //  like 256–1024B tend to stay within the same row.)
-    char *C = A + 512; // small column offset guess
+    // Same-row candidate C: HIT_DELTA bytes away in *physical* memory, so it
+    // shares A's row regardless of how the virtual pages were placed.
+    char *C = arena_partner(&ar, A, HIT_DELTA);
+    if (!C) C = A + HIT_DELTA;   // same 4 KiB page, so physically adjacent anyway
 
+    double ctr_hit[PMU_NEVENTS], ctr_noconf[PMU_NEVENTS], ctr_conf[PMU_NEVENTS];
     uint64_t med_hit = time_ABA(A, C);       // likely row-hit
+    memcpy(ctr_hit, aba_ctr, sizeof(aba_ctr));
     uint64_t med_noconf = time_ABA(A, B_min); // different bank or benign mapping
+    memcpy(ctr_noconf, aba_ctr, sizeof(aba_ctr));
     uint64_t med_conf = time_ABA(A, B_max);   // likely same-bank different-row (row conflict)
+    memcpy(ctr_conf, aba_ctr, sizeof(aba_ctr));
+
+    printf("Addresses:\n");
+    print_pa("A", &ar, A);
+    print_pa("C", &ar, C);
+    print_pa("B_min", &ar, B_min);
+    print_pa("B_max", &ar, B_max);
+    if (pa_A != ARENA_PA_NONE) {
+        long long dmax = (long long)(arena_pa(&ar, B_max) - pa_A);
+        long long dmin = (long long)(arena_pa(&ar, B_min) - pa_A);
+        printf("  reuse without rescanning: -c %lld -n %lld\n", dmax, dmin);
+    }
 
-    printf("Results (median ticks):\n");
-    printf("  Row-hit      (A->C->A, C=A+512):         %" PRIu64 "\n", med_hit);
-    printf("  No-conflict  (A->Bmin->A):               %" PRIu64 "\n", best_min);
-    printf("  Row-conflict (A->Bmax->A):               %" PRIu64 "\n", best_max);
+    printf("Results (median ticks net of %" PRIu64 "-tick timer overhead, ns):\n",
+           tcal.overhead[TF_LFENCE]);
+    printf("  Row-hit      (A->C->A, C=A+%d phys):     %" PRIu64 "  %7.1f ns\n", HIT_DELTA,
+           med_hit, ticks_ns((double)med_hit));
+    printf("  No-conflict  (A->Bmin->A):               %" PRIu64 "  %7.1f ns\n", best_min,
+           ticks_ns((double)best_min));
+    printf("  Row-conflict (A->Bmax->A):               %" PRIu64 "  %7.1f ns\n", best_max,
+           ticks_ns((double)best_max));
+    if (aba_pmu) {
+        printf("Counters (mean per sample):\n");
+        print_ctr("Row-hit", ctr_hit);
+        print_ctr("No-conflict", ctr_noconf);
+        print_ctr("Row-conflict", ctr_conf);
+    }
 
     printf("\nInterpretation:\n");
     if (med_conf > med_hit * 1.5 && med_conf > med_noconf * 1.5) {
@@ -115,10 +193,12 @@ int main(void) {
                 (llabs((long long)med_conf - (long long)med_hit) < (long long)(0.2*med_hit)) ) {
         printf("  All similar ⇒ Controller behaves CLOSED-ROW (or aggressively close-page).\n");
     } else {
-        printf("  Mixed deltas ⇒ Behavior might be adaptive/hybrid; try different A or strides.\n");
+        printf("  Mixed deltas ⇒ Behavior might be adaptive/hybrid; try different A or strides%s.\n",
+               gap_max_us > 0 ? "" : ", or -g 50 to look for a page-close timeout");
     }
+    if (gap_max_us > 0) gap_sweep(A, C, gap_max_us * 1000);
 
-    free(arena);
+    pmu_close(&pmu);
+    arena_free(&ar);
     return 0;
 }
-
@@ -0,0 +1,175 @@
+// patterns.c -- access patterns vs the hardware prefetchers.
+//
+// The memcpy tests only stream forward and the row probes touch fixed
+// offsets, so neither says which layouts the prefetchers actually help.
+// Here one -M MiB arena is visited line by line in each of walk.h's
+// orders -- seq-fwd, seq-bwd, stride-N for N = 128 B .. -S, tile and rand,
+// every one covering each line exactly once -- and for each order we measure
+//   GB/s   independent 8-byte loads, one per line, in that order (the
+//          order itself is read from a uint32 index array, +6% traffic);
+//   ns     a pointer chain through the lines in the same order, so each
+//          load waits for the previous one and only a prefetch can help.
+// With root and the msr module on an Intel CPU the whole set is repeated
+// with the prefetchers in MSR 0x1A4 switched off in turn (msr.h); the
+// register is restored on exit. Otherwise only the current setting runs.
+//
+// usage: ./patterns [-M MiB] [-S max_stride] [-p 4k|thp|2m|1g] [-c cpu] [-o patterns.csv]
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <signal.h>
+#include "bench.h"
+#include "arena.h"
+#include "chase.h"
+#include "msr.h"
+#include "walk.h"
+
+#define MIN_SEC      0.1        // per bandwidth point
+#define MIN_LOADS    (1L << 20)
+#define MAX_LOADS    (1L << 23)
+#define MAX_PATTERNS 24
+#define MAX_CONFIGS  8
+
+struct pf_config {
+    const char *name;
+    int off;                    // MSR_PF_* bits to disable, -1 = leave alone
+};
+
+static const struct pf_config pf_all[] = {
+    { "on",        0 },
+    { "no-l2",     MSR_PF_L2_STREAM },
+    { "no-adj",    MSR_PF_L2_ADJ },
+    { "no-l2+adj", MSR_PF_L2_STREAM | MSR_PF_L2_ADJ },
+    { "none",      MSR_PF_ALL },
+};
+static const struct pf_config pf_asis = { "as-is", -1 };
+
+static struct msr_prefetch msr = { .fd = -1 };
+
+static void restore_msr(void) { msr_prefetch_close(&msr); }
+static void on_signal(int sig) { (void)sig; exit(130); }    // runs restore_msr
+
+static double bandwidth(const char *base, const uint32_t *idx, size_t n) {
+    uint64_t sum = walk_load_pass(base, idx, n);             // warm TLB / path
+    long passes = 0;
+    double t0 = now_sec(), t1;
+    do { sum += walk_load_pass(base, idx, n); ++passes; } while ((t1 = now_sec()) - t0 < MIN_SEC);
+    asm volatile("" :: "r"(sum));
+    return (double)passes * (double)n * CACHELINE / (t1 - t0) / 1e9;
+}
+
+// Chains the lines in idx order (last back to first) and walks the chain.
+static double latency(char *base, const uint32_t *idx, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+        *(void **)(base + (size_t)idx[i] * CACHELINE) = base + (size_t)idx[(i + 1) % n] * CACHELINE;
+    long loads = (long)n;
+    if (loads < MIN_LOADS) loads = MIN_LOADS;
+    if (loads > MAX_LOADS) loads = MAX_LOADS;
+    return chase_ns((void **)(base + (size_t)idx[0] * CACHELINE), loads);
+}
+
+static int make_patterns(struct pattern *p, size_t max_stride) {
+    int n = 0;
+    p[n++] = (struct pattern){ "seq-fwd", W_SEQ_FWD, 0 };
+    p[n++] = (struct pattern){ "seq-bwd", W_SEQ_BWD, 0 };
+    for (size_t s = 2 * CACHELINE; s <= max_stride && n < MAX_PATTERNS - 2; s <<= 1) {
+        p[n] = (struct pattern){ "", W_STRIDE, s / CACHELINE };
+        snprintf(p[n++].name, sizeof(p->name), "stride-%zu", s);
+    }
+    p[n] = (struct pattern){ "", W_TILE, 0 };
+    snprintf(p[n++].name, sizeof(p->name), "tile-%dx%d", TILE_W, TILE_H);
+    p[n++] = (struct pattern){ "rand", W_RAND, 0 };
+    return n;
+}
+
+int main(int ac, char **av) {
+    size_t mb = 64, max_stride = 8192;
+    enum arena_backing backing = ARENA_THP;
+    const char *out_path = "patterns.csv";
+    int cpu = -1, opt;
+    while ((opt = getopt(ac, av, "M:S:p:c:o:")) != -1) {
+        switch (opt) {
+        case 'M': mb = (size_t)atol(optarg); break;
+        case 'S': max_stride = (size_t)atol(optarg); break;
+        case 'p': if (arena_parse_backing(optarg, &backing)) goto usage; break;
+        case 'c': cpu = atoi(optarg); break;
+        case 'o': out_path = optarg; break;
+        default:  goto usage;
+        }
+    }
+    if (mb < 1 || max_stride < 2 * CACHELINE) goto usage;
+
+    if (cpu < 0 && allowed_cpus(&cpu, 1) < 1) cpu = 0;
+    if (pin_cpu(cpu)) { fprintf(stderr, "cannot pin to cpu %d\n", cpu); return 1; }
+
+    const struct pf_config *cfg = &pf_asis;
+    int ncfg = 1;
+    if (!msr_prefetch_open(&msr, cpu)) {
+        atexit(restore_msr);
+        signal(SIGINT, on_signal);
+        signal(SIGTERM, on_signal);
+        cfg = pf_all;
+        ncfg = (int)(sizeof(pf_all) / sizeof(pf_all[0]));
+        printf("cpu %d: MSR 0x%x = 0x%llx, prefetchers will be toggled\n", cpu,
+               MSR_MISC_FEATURE_CONTROL, (unsigned long long)msr.saved);
+    } else {
+        printf("cpu %d: prefetchers left as they are\n", cpu);
+    }
+
+    struct arena ar;
+    if (arena_alloc(&ar, mb << 20, backing)) return 1;
+    memset(ar.base, 0, ar.bytes);
+    size_t n = ar.bytes / CACHELINE;
+    uint32_t *idx = (uint32_t *)xalloc(CACHELINE, n * sizeof(uint32_t));
+
+    static struct pattern pat[MAX_PATTERNS];
+    static double bw[MAX_PATTERNS][MAX_CONFIGS], lat[MAX_PATTERNS][MAX_CONFIGS];
+    int npat = make_patterns(pat, max_stride);
+
+    FILE *out = fopen(out_path, "w");
+    if (!out) { perror(out_path); return 1; }
+    fprintf(out, "Pattern,Prefetch,GBps,LatNs\n");
+    printf("%zu MiB on %s pages\n", ar.bytes >> 20, arena_backing_name[ar.kind]);
+
+    for (int c = 0; c < ncfg; ++c) {
+        if (cfg[c].off >= 0 && msr_prefetch_set(&msr, (unsigned)cfg[c].off)) return 1;
+        for (int i = 0; i < npat; ++i) {
+            walk_fill(&pat[i], idx, n);
+            bw[i][c] = bandwidth(ar.base, idx, n);
+            lat[i][c] = latency(ar.base, idx, n);
+            printf("  %-10s %-12s %8.2f GB/s  %7.2f ns\n", cfg[c].name, pat[i].name,
+                   bw[i][c], lat[i][c]);
+            fprintf(out, "%s,%s,%.3f,%.2f\n", pat[i].name, cfg[c].name, bw[i][c], lat[i][c]);
+            fflush(stdout);
+        }
+    }
+
+    printf("\nGB/s (left), ns per dependent load (right)\n%-12s", "");
+    for (int c = 0; c < ncfg; ++c) printf(" %10s", cfg[c].name);
+    printf("   |   ");
+    for (int c = 0; c < ncfg; ++c) printf(" %10s", cfg[c].name);
+    printf("\n");
+    for (int i = 0; i < npat; ++i) {
+        printf("%-12s", pat[i].name);
+        for (int c = 0; c < ncfg; ++c) printf(" %10.2f", bw[i][c]);
+        printf("   |   ");
+        for (int c = 0; c < ncfg; ++c) printf(" %10.2f", lat[i][c]);
+        printf("\n");
+    }
+    if (ncfg > 1) {                     // "on" is column 0, "none" the last
+        printf("\nprefetcher benefit (on vs none):\n");
+        for (int i = 0; i < npat; ++i)
+            printf("  %-12s %5.2fx bandwidth, %+7.2f ns per dependent load\n", pat[i].name,
+                   bw[i][0] / bw[i][ncfg - 1], lat[i][0] - lat[i][ncfg - 1]);
+    }
+    printf("wrote %s\n", out_path);
+
+    fclose(out);
+    free(idx);
+    arena_free(&ar);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-M MiB] [-S max_stride] [-p 4k|thp|2m|1g] [-c cpu] "
+                    "[-o patterns.csv]\n", av[0]);
+    return 1;
+}
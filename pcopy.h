@@ -0,0 +1,159 @@
+// pcopy.h -- parallel chunked memcpy on a persistent, pinned thread pool.
+//
+// One core's memcpy cannot keep enough misses in flight to use the
+// socket's bandwidth (memcpy_mt.c shows the scaling). pcopy() splits one
+// copy into per-thread chunks whose boundaries fall on dst cache lines, so
+// no two threads ever write the same line, and runs them on workers that
+// were created and pinned once by pcopy_init(). The calling thread takes
+// the first chunk itself and then waits for the rest.
+//
+// Copies of at least `nt_min` bytes use streaming stores (copy_nt in
+// copy_kernels.h): a copy that large would only evict the working set and
+// the destination is not going to be read back from cache anyway. A copy
+// is split only into as many chunks as it has PCOPY_MIN_CHUNK pieces, so a
+// small copy runs on the caller alone and costs one memcpy.
+//
+// Idle workers spin for PCOPY_SPIN polls (a dispatch is then ~100 ns)
+// and after that sleep on a condition variable. One pool serves one
+// caller at a time; memcpy rules apply (no overlap).
+#ifndef PCOPY_H
+#define PCOPY_H
+
+#include "bench.h"
+#include "copy_kernels.h"
+
+#define PCOPY_MAX_THREADS 64
+#define PCOPY_MIN_CHUNK   (16 * 1024)
+#define PCOPY_SPIN        (1 << 16)
+
+struct pcopy_pool {
+    int nthreads;                       // including the caller
+    int cpu[PCOPY_MAX_THREADS];
+    pthread_t th[PCOPY_MAX_THREADS];
+    size_t nt_min;
+
+    // current job, published by bumping gen
+    char *dst;
+    const char *src;
+    size_t n, chunk;
+    int nchunks;
+    copy_fn fn;
+
+    unsigned gen;                       // __atomic; changes under mu
+    int pending;                        // workers that have not finished this gen
+    int sleepers, quit;
+    pthread_mutex_t mu;
+    pthread_cond_t cv;
+};
+
+struct pcopy_arg { struct pcopy_pool *p; int id; };
+
+// Byte offset where chunk i starts: i*chunk rounded up to a dst line.
+static inline size_t pcopy_start(const struct pcopy_pool *p, int i) {
+    if (i == 0) return 0;
+    if (i >= p->nchunks) return p->n;
+    uintptr_t a = ((uintptr_t)p->dst + (size_t)i * p->chunk + CACHELINE - 1) & ~(uintptr_t)(CACHELINE - 1);
+    size_t off = (size_t)(a - (uintptr_t)p->dst);
+    return off < p->n ? off : p->n;
+}
+
+static inline void pcopy_chunk(const struct pcopy_pool *p, int i) {
+    size_t a = pcopy_start(p, i), b = pcopy_start(p, i + 1);
+    if (b > a) p->fn(p->dst + a, p->src + a, b - a);
+}
+
+static inline unsigned pcopy_wait(struct pcopy_pool *p, unsigned seen) {
+    unsigned g;
+    for (int i = 0; i < PCOPY_SPIN; ++i) {
+        if ((g = __atomic_load_n(&p->gen, __ATOMIC_ACQUIRE)) != seen) return g;
+        _mm_pause();
+    }
+    pthread_mutex_lock(&p->mu);
+    ++p->sleepers;
+    while ((g = __atomic_load_n(&p->gen, __ATOMIC_ACQUIRE)) == seen)
+        pthread_cond_wait(&p->cv, &p->mu);
+    --p->sleepers;
+    pthread_mutex_unlock(&p->mu);
+    return g;
+}
+
+static void *pcopy_worker(void *arg) {
+    struct pcopy_pool *p = ((struct pcopy_arg *)arg)->p;
+    int id = ((struct pcopy_arg *)arg)->id;
+    free(arg);
+    if (pin_cpu(p->cpu[id])) fprintf(stderr, "pcopy: could not pin to cpu %d\n", p->cpu[id]);
+    unsigned seen = 0;
+    for (;;) {
+        seen = pcopy_wait(p, seen);
+        if (__atomic_load_n(&p->quit, __ATOMIC_ACQUIRE)) break;
+        if (id < p->nchunks) pcopy_chunk(p, id);
+        // every worker acks every job, so none can still be looking at
+        // this one when the caller publishes the next
+        __atomic_fetch_sub(&p->pending, 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static inline void pcopy_publish(struct pcopy_pool *p) {
+    pthread_mutex_lock(&p->mu);
+    __atomic_add_fetch(&p->gen, 1, __ATOMIC_RELEASE);
+    if (p->sleepers) pthread_cond_broadcast(&p->cv);
+    pthread_mutex_unlock(&p->mu);
+}
+
+// Starts nthreads-1 workers pinned to cpus[1..] and pins the calling
+// thread to cpus[0]. Copies of >= nt_min bytes use streaming stores
+// (SIZE_MAX: never; about half the LLC is a good start). 0 on success.
+static inline int pcopy_init(struct pcopy_pool *p, int nthreads, const int *cpus, size_t nt_min) {
+    memset(p, 0, sizeof(*p));
+    if (nthreads < 1 || nthreads > PCOPY_MAX_THREADS) {
+        fprintf(stderr, "pcopy: %d threads, must be 1..%d\n", nthreads, PCOPY_MAX_THREADS);
+        return -1;
+    }
+    copy_kernels_init();
+    p->nthreads = nthreads;
+    p->nt_min = nt_min;
+    memcpy(p->cpu, cpus, (size_t)nthreads * sizeof(int));
+    pthread_mutex_init(&p->mu, NULL);
+    pthread_cond_init(&p->cv, NULL);
+    if (pin_cpu(cpus[0])) fprintf(stderr, "pcopy: could not pin caller to cpu %d\n", cpus[0]);
+    for (int i = 1; i < nthreads; ++i) {
+        struct pcopy_arg *a = (struct pcopy_arg *)malloc(sizeof(*a));
+        a->p = p;
+        a->id = i;
+        if (pthread_create(&p->th[i], NULL, pcopy_worker, a)) {
+            perror("pcopy: pthread_create");
+            p->nthreads = i;                    // let pcopy_destroy join the rest
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static inline void pcopy(struct pcopy_pool *p, void *dst, const void *src, size_t n) {
+    copy_fn fn = n >= p->nt_min ? copy_nt : copy_libc;
+    size_t k = n / PCOPY_MIN_CHUNK;
+    if (k > (size_t)p->nthreads) k = (size_t)p->nthreads;
+    if (k <= 1) { fn(dst, src, n); return; }
+
+    p->dst = (char *)dst;
+    p->src = (const char *)src;
+    p->n = n;
+    p->nchunks = (int)k;
+    p->chunk = n / k;
+    p->fn = fn;
+    __atomic_store_n(&p->pending, p->nthreads - 1, __ATOMIC_RELAXED);
+    pcopy_publish(p);
+    pcopy_chunk(p, 0);
+    while (__atomic_load_n(&p->pending, __ATOMIC_ACQUIRE)) _mm_pause();
+}
+
+static inline void pcopy_destroy(struct pcopy_pool *p) {
+    __atomic_store_n(&p->quit, 1, __ATOMIC_RELEASE);
+    pcopy_publish(p);
+    for (int i = 1; i < p->nthreads; ++i) pthread_join(p->th[i], NULL);
+    pthread_mutex_destroy(&p->mu);
+    pthread_cond_destroy(&p->cv);
+}
+
+#endif // PCOPY_H
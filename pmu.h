@@ -0,0 +1,266 @@
+// pmu.h -- hardware counters around the timed regions.
+//
+// A TSC delta alone does not say why a sample was slow. pmu_open() opens a
+// perf_event group on the calling thread -- cycles, instructions,
+// LLC-load-misses, dTLB-load-misses -- plus, where the kernel exposes an
+// integrated memory controller PMU (uncore_imc_*), the socket's CAS read,
+// CAS write and ACT counts. pmu_read() snapshots every counter; callers read
+// once before tsc_begin() and once after tsc_end(), so the counter reads
+// stay outside the timed window, and store the difference next to the
+// sample (sink_record_ctr() in sample_sink.h).
+//
+// Core counters are read with rdpmc through the perf mmap page when the
+// kernel allows it (/sys/bus/event_source/devices/cpu/rdpmc), otherwise
+// with one read() of the whole group. Uncore counters are socket-wide and
+// always need a read() per box. Anything that cannot be opened -- no PMU in
+// a VM, perf_event_paranoid too high, no root for uncore -- is dropped with
+// a one-line note; with nothing left pmu.n is 0 and the harness runs as
+// before.
+#ifndef PMU_H
+#define PMU_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <x86intrin.h>
+
+enum pmu_event { PMU_CYCLES, PMU_INSTR, PMU_LLC_MISS, PMU_DTLB_MISS,
+                 PMU_CAS_RD, PMU_CAS_WR, PMU_ACT, PMU_NEVENTS };
+
+__attribute__((unused))
+static const char *pmu_event_name[PMU_NEVENTS] = {
+    "cycles", "instructions", "LLC-load-misses", "dTLB-load-misses",
+    "cas-rd", "cas-wr", "act"
+};
+
+// sysfs event aliases tried for the uncore columns, in order.
+__attribute__((unused))
+static const char *pmu_uncore_alias[PMU_NEVENTS][3] = {
+    [PMU_CAS_RD] = { "cas_count_read", "cas_count_rd", NULL },
+    [PMU_CAS_WR] = { "cas_count_write", "cas_count_wr", NULL },
+    [PMU_ACT]    = { "act_count", "act_count.all", NULL },
+};
+
+#define PMU_MAX_BOXES 16        // IMC channels summed per uncore column
+#define PAGE_SIZE_PMU 4096      // perf mmap: metadata page only, no ring
+
+struct pmu {
+    int n;                              // open columns
+    enum pmu_event ev[PMU_NEVENTS];     // event of each column
+    const char *name[PMU_NEVENTS];
+    int ncore;                          // columns [0, ncore) are in the core group
+    int fd[PMU_NEVENTS];
+    struct perf_event_mmap_page *pg[PMU_NEVENTS];
+    int ufd[PMU_NEVENTS][PMU_MAX_BOXES];
+    int nbox[PMU_NEVENTS];
+    int use_rdpmc;
+};
+
+static inline int pmu_sys_open(struct perf_event_attr *a, pid_t pid, int cpu, int group) {
+    return (int)syscall(SYS_perf_event_open, a, pid, cpu, group, 0);
+}
+
+// Reads a small sysfs file into buf; returns 0 on success.
+static inline int pmu_slurp(const char *path, char *buf, size_t len) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    size_t n = fread(buf, 1, len - 1, f);
+    fclose(f);
+    buf[n] = 0;
+    while (n && (buf[n - 1] == '\n' || buf[n - 1] == ' ')) buf[--n] = 0;
+    return n ? 0 : -1;
+}
+
+// Translates an event string such as "event=0x04,umask=0x03" into
+// attr.config using the PMU's format/ files ("config:0-7"). 0 on success.
+static inline int pmu_parse_event(const char *dev, const char *spec, uint64_t *config) {
+    char s[256], path[256], fmt[64];
+    snprintf(s, sizeof(s), "%s", spec);
+    *config = 0;
+    for (char *save = NULL, *tok = strtok_r(s, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        char *eq = strchr(tok, '=');
+        uint64_t val = 1;
+        if (eq) { *eq = 0; val = strtoull(eq + 1, NULL, 0); }
+        snprintf(path, sizeof(path), "%s/format/%s", dev, tok);
+        int lo, hi;
+        if (pmu_slurp(path, fmt, sizeof(fmt))) return -1;
+        int k = sscanf(fmt, "config:%d-%d", &lo, &hi);
+        if (k < 1) return -1;               // config1/config2 fields: not needed here
+        if (k == 1) hi = lo;
+        uint64_t mask = hi - lo >= 63 ? ~0ULL : ((1ULL << (hi - lo + 1)) - 1);
+        *config |= (val & mask) << lo;
+    }
+    return 0;
+}
+
+static inline int pmu_open_core(struct pmu *p, enum pmu_event e, uint32_t type, uint64_t config) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.size = sizeof(a);
+    a.type = type;
+    a.config = config;
+    a.exclude_kernel = 1;               // works at perf_event_paranoid <= 2
+    a.exclude_hv = 1;
+    a.read_format = PERF_FORMAT_GROUP;
+    int leader = p->ncore ? p->fd[0] : -1;
+    a.disabled = leader < 0;
+    a.pinned = leader < 0;
+    int fd = pmu_sys_open(&a, 0, -1, leader);
+    if (fd < 0) return -1;
+    int c = p->n;
+    p->ev[c] = e;
+    p->name[c] = pmu_event_name[e];
+    p->fd[c] = fd;
+    p->pg[c] = (struct perf_event_mmap_page *)mmap(NULL, PAGE_SIZE_PMU, PROT_READ, MAP_SHARED, fd, 0);
+    if (p->pg[c] == MAP_FAILED) p->pg[c] = NULL;
+    p->n++;
+    p->ncore++;
+    return 0;
+}
+
+// Sums one sysfs event over every uncore_imc_* box of the current socket.
+static inline int pmu_open_uncore(struct pmu *p, enum pmu_event e) {
+    int c = p->n, cpu = sched_getcpu();
+    p->nbox[c] = 0;
+    for (int box = 0; box < 64 && p->nbox[c] < PMU_MAX_BOXES; ++box) {
+        char dev[128], path[256], buf[128];
+        int single = 0;
+        snprintf(dev, sizeof(dev), "/sys/bus/event_source/devices/uncore_imc_%d", box);
+        snprintf(path, sizeof(path), "%s/type", dev);
+        if (pmu_slurp(path, buf, sizeof(buf))) {
+            if (box) break;
+            // some kernels expose a single box as plain "uncore_imc"
+            snprintf(dev, sizeof(dev), "/sys/bus/event_source/devices/uncore_imc");
+            snprintf(path, sizeof(path), "%s/type", dev);
+            if (pmu_slurp(path, buf, sizeof(buf))) break;
+            single = 1;
+        }
+        uint32_t type = (uint32_t)strtoul(buf, NULL, 0);
+        uint64_t config;
+        int found = 0;
+        for (int k = 0; k < 3 && pmu_uncore_alias[e][k]; ++k) {
+            snprintf(path, sizeof(path), "%s/events/%s", dev, pmu_uncore_alias[e][k]);
+            if (!pmu_slurp(path, buf, sizeof(buf)) && !pmu_parse_event(dev, buf, &config)) {
+                found = 1;
+                break;
+            }
+        }
+        if (!found) { if (single) break; continue; }
+        struct perf_event_attr a;
+        memset(&a, 0, sizeof(a));
+        a.size = sizeof(a);
+        a.type = type;
+        a.config = config;
+        a.disabled = 1;
+        int fd = pmu_sys_open(&a, -1, cpu < 0 ? 0 : cpu, -1);   // uncore: per socket, no task
+        if (fd >= 0) p->ufd[c][p->nbox[c]++] = fd;
+        if (single) break;
+    }
+    if (!p->nbox[c]) return -1;
+    p->ev[c] = e;
+    p->name[c] = pmu_event_name[e];
+    p->fd[c] = -1;
+    p->pg[c] = NULL;
+    p->n++;
+    return 0;
+}
+
+// Opens every counter it can; returns the number of columns (0 if the PMU
+// is unusable). `uncore` = 0 skips the memory-controller counters.
+static inline int pmu_open(struct pmu *p, int uncore) {
+    memset(p, 0, sizeof(*p));
+    static const struct { enum pmu_event e; uint32_t type; uint64_t config; } core[] = {
+        { PMU_CYCLES,    PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PMU_INSTR,     PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PMU_LLC_MISS,  PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL |
+                         (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PMU_DTLB_MISS, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+                         (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    };
+    for (size_t i = 0; i < sizeof(core) / sizeof(core[0]); ++i) {
+        if (pmu_open_core(p, core[i].e, core[i].type, core[i].config) == 0) continue;
+        if (i == 0) {
+            fprintf(stderr, "pmu: cycles counter unavailable (%s), core counters off\n",
+                    strerror(errno));
+            break;
+        }
+        fprintf(stderr, "pmu: %s unavailable, column dropped\n", pmu_event_name[core[i].e]);
+    }
+    if (uncore) {
+        int got = 0;
+        for (int e = PMU_CAS_RD; e <= PMU_ACT; ++e) got += pmu_open_uncore(p, (enum pmu_event)e) == 0;
+        if (!got) fprintf(stderr, "pmu: no uncore IMC counters (needs root and uncore_imc)\n");
+    }
+
+    p->use_rdpmc = p->ncore > 0;
+    for (int c = 0; c < p->ncore; ++c)
+        if (!p->pg[c] || !p->pg[c]->cap_user_rdpmc) p->use_rdpmc = 0;
+    if (p->ncore) {
+        ioctl(p->fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(p->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    for (int c = p->ncore; c < p->n; ++c)
+        for (int b = 0; b < p->nbox[c]; ++b) ioctl(p->ufd[c][b], PERF_EVENT_IOC_ENABLE, 0);
+    return p->n;
+}
+
+static inline void pmu_close(struct pmu *p) {
+    for (int c = 0; c < p->n; ++c) {
+        if (p->pg[c]) munmap(p->pg[c], PAGE_SIZE_PMU);
+        if (p->fd[c] >= 0) close(p->fd[c]);
+        for (int b = 0; b < p->nbox[c]; ++b) close(p->ufd[c][b]);
+    }
+    p->n = p->ncore = 0;
+}
+
+// Self-monitoring read of one counter via its mmap page (perf_event.h).
+static inline uint64_t pmu_rdpmc(const struct perf_event_mmap_page *pc) {
+    uint32_t seq, idx;
+    uint64_t count;
+    do {
+        seq = pc->lock;
+        asm volatile("" ::: "memory");
+        idx = pc->index;
+        count = (uint64_t)pc->offset;
+        if (idx) {
+            unsigned w = pc->pmc_width;
+            int64_t v = (int64_t)__rdpmc((int)idx - 1);
+            count += (uint64_t)((v << (64 - w)) >> (64 - w));
+        }
+        asm volatile("" ::: "memory");
+    } while (pc->lock != seq);
+    return count;
+}
+
+// Snapshots all columns into v[0..p->n).
+static inline void pmu_read(const struct pmu *p, uint64_t *v) {
+    if (p->use_rdpmc) {
+        for (int c = 0; c < p->ncore; ++c) v[c] = pmu_rdpmc(p->pg[c]);
+    } else if (p->ncore) {
+        uint64_t buf[1 + PMU_NEVENTS];          // PERF_FORMAT_GROUP: nr, values...
+        if (read(p->fd[0], buf, sizeof(buf)) > 0)
+            for (int c = 0; c < p->ncore && c < (int)buf[0]; ++c) v[c] = buf[1 + c];
+    }
+    for (int c = p->ncore; c < p->n; ++c) {
+        v[c] = 0;
+        for (int b = 0; b < p->nbox[c]; ++b) {
+            uint64_t x = 0;
+            if (read(p->ufd[c][b], &x, sizeof(x)) == sizeof(x)) v[c] += x;
+        }
+    }
+}
+
+// d[c] = b[c] - a[c] for every column.
+static inline void pmu_delta(const struct pmu *p, const uint64_t *a, const uint64_t *b, uint64_t *d) {
+    for (int c = 0; c < p->n; ++c) d[c] = b[c] - a[c];
+}
+
+#endif // PMU_H
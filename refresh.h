@@ -0,0 +1,220 @@
+// refresh.h -- find DRAM refresh stalls in a timestamped latency series.
+//
+// An averaged latency (rowalign.c's clock1, row_total.c's sum_same_total)
+// hides refresh: every tREFI (7.8 us on DDR4, 3.9 us on DDR5, /2 or /4 in
+// fine-granularity modes) a rank is busy for tRFC (a few hundred ns) and a
+// miss that arrives then waits. refresh_detect() takes per-sample TSC
+// timestamps and latencies from one pinned core and
+//   1. marks spikes: latency > median + max(REF_K_MAD x MAD, REF_MIN_EXCESS
+//      x median);
+//   2. computes a Welch-style averaged Rayleigh periodogram of the spike
+//      times over REF_MIN_NS..REF_MAX_NS (|sum e^(2 pi i t/P)|^2 / count
+//      per REF_WIN_NS window, averaged; ~1 for random spikes, ~spikes per
+//      window for periodic ones), takes the longest period within
+//      REF_HARMONIC of the peak -- P/2, P/3 .. are as coherent as P, 2P is
+//      not -- and refines it on a REF_FINE times finer grid;
+//   3. measures the phase of that period separately in each REF_WIN_NS
+//      window: controllers postpone and pull in refreshes and the memory
+//      clock is not the TSC, so one phase for a whole run drifts;
+//   4. folds the spikes onto their window's phase: the phase range holding
+//      the in-phase spikes is where refresh hits, the excess latency of the
+//      samples inside it estimates tRFC.
+// refresh_affected() then flags a sample (spike inside the range) so a
+// benchmark can exclude or report it. The phases only cover the series
+// they were measured on; refresh_free() releases them.
+#ifndef REFRESH_H
+#define REFRESH_H
+
+#include "bench.h"
+#include <math.h>
+
+#define REF_K_MAD       8.0
+#define REF_MIN_EXCESS  0.5
+#define REF_MIN_NS      1000        // periodogram range and step
+#define REF_MAX_NS      20000
+#define REF_STEP_NS     10
+#define REF_NSPEC       ((REF_MAX_NS - REF_MIN_NS) / REF_STEP_NS + 1)
+#define REF_FINE        50          // refinement points per REF_STEP_NS
+#define REF_WIN_NS      200000.0
+#define REF_WIN_SPIKES  3           // fewer in a window: keep the previous phase
+#define REF_SCAN_SPIKES 4000        // spikes used for the periodogram
+#define REF_HARMONIC    0.7
+#define REF_MIN_SPIKES  20
+#define REF_MIN_POWER   4.0         // periodogram peak needed to call it periodic
+#define REF_MIN_COHER   0.3         // spike-weighted mean of per-window coherence
+
+struct refresh_model {
+    int detected;
+    uint64_t median, mad, thr;      // ticks
+    size_t nspikes, naffected;
+    double period;                  // ticks
+    uint64_t w0;                    // tsc of window 0's start
+    double win;                     // window length, ticks
+    size_t nwin;
+    double *phase;                  // per window: refreshes at (t - w0)/period = phase + k
+    double win_lo, win_hi;          // affected phase range, fractions of a period
+    double power, coherence;        // periodogram peak, mean per-window Rayleigh R
+    double stall_mean, trfc;        // mean and p95 excess ticks of affected samples
+    double periods_hit;             // fraction of refresh periods with a hit sample
+    double spec[REF_NSPEC];         // averaged periodogram, REF_MIN_NS + i*REF_STEP_NS
+};
+
+// Phase of `ts` in [-0.5, 0.5) periods from the nearest refresh.
+static inline double refresh_phase(const struct refresh_model *m, uint64_t ts) {
+    double t = ts > m->w0 ? (double)(ts - m->w0) : 0;
+    size_t w = (size_t)(t / m->win);
+    if (w >= m->nwin) w = m->nwin - 1;
+    double x = t / m->period - m->phase[w];
+    return x - floor(x + 0.5);
+}
+
+static inline int refresh_in_window(const struct refresh_model *m, uint64_t ts) {
+    if (!m->detected) return 0;
+    double ph = refresh_phase(m, ts);
+    return ph >= m->win_lo && ph <= m->win_hi;
+}
+
+// 1 if the sample at `ts` with latency `lat` ticks was hit by refresh.
+static inline int refresh_affected(const struct refresh_model *m, uint64_t ts, uint64_t lat) {
+    return lat > m->thr && refresh_in_window(m, ts);
+}
+
+static inline void refresh_free(struct refresh_model *m) {
+    free(m->phase);
+    m->phase = NULL;
+    m->detected = 0;
+}
+
+static inline int refresh_cmp_dbl(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Averaged Rayleigh power of spike times `sp` at `period` ticks.
+static inline double refresh_power(const uint64_t *sp, size_t n, double period, double win) {
+    double sum = 0, c = 0, s = 0;
+    int windows = 0;
+    size_t cnt = 0;
+    uint64_t w0 = sp[0];
+    for (size_t i = 0; i <= n; ++i) {
+        if (i == n || (double)(sp[i] - w0) >= win) {
+            if (cnt) { sum += (c * c + s * s) / (double)cnt; ++windows; }
+            if (i == n) break;
+            w0 = sp[i]; c = s = 0; cnt = 0;
+        }
+        double th = 2 * M_PI * (double)(sp[i] - w0) / period;
+        c += cos(th);
+        s += sin(th);
+        ++cnt;
+    }
+    return windows ? sum / windows : 0;
+}
+
+// Fills `m` from n samples in time order (ts = TSC at issue, lat = ticks).
+// 0 if a periodic component was found, -1 otherwise (m->detected = 0, the
+// spike statistics and periodogram are still filled in). Call
+// refresh_free() when done either way.
+static inline int refresh_detect(const uint64_t *ts, const uint64_t *lat, size_t n,
+                                 struct refresh_model *m) {
+    memset(m, 0, sizeof(*m));
+    m->thr = UINT64_MAX;
+    if (n < 16) return -1;
+    uint64_t *tmp = (uint64_t *)xalloc(CACHELINE, n * sizeof(uint64_t));
+    memcpy(tmp, lat, n * sizeof(uint64_t));
+    qsort(tmp, n, sizeof(uint64_t), cmp_u64);
+    m->median = tmp[n / 2];
+    for (size_t i = 0; i < n; ++i) tmp[i] = lat[i] > m->median ? lat[i] - m->median : m->median - lat[i];
+    qsort(tmp, n, sizeof(uint64_t), cmp_u64);
+    m->mad = tmp[n / 2];
+    double extra = REF_K_MAD * (double)m->mad;
+    if (extra < REF_MIN_EXCESS * (double)m->median) extra = REF_MIN_EXCESS * (double)m->median;
+    m->thr = m->median + (uint64_t)extra;
+
+    uint64_t *sp = tmp;             // spike timestamps, in time order
+    for (size_t i = 0; i < n; ++i)
+        if (lat[i] > m->thr) sp[m->nspikes++] = ts[i];
+    if (m->nspikes < REF_MIN_SPIKES) { free(tmp); return -1; }
+
+    // 2. periodogram over the first REF_SCAN_SPIKES spikes
+    size_t nscan = m->nspikes < REF_SCAN_SPIKES ? m->nspikes : REF_SCAN_SPIKES;
+    m->win = (double)ns_ticks(REF_WIN_NS);
+    int best = 0;
+    for (int i = 0; i < REF_NSPEC; ++i) {
+        m->spec[i] = refresh_power(sp, nscan, (REF_MIN_NS + i * REF_STEP_NS) * tcal.ghz, m->win);
+        if (m->spec[i] > m->spec[best]) best = i;
+    }
+    m->power = m->spec[best];
+    for (int i = REF_NSPEC - 1; i > best; --i)
+        if (m->spec[i] >= REF_HARMONIC * m->power
+            && (i + 1 == REF_NSPEC || m->spec[i] >= m->spec[i + 1])
+            && m->spec[i] >= m->spec[i - 1]) { best = i; break; }
+    double center = (REF_MIN_NS + best * REF_STEP_NS) * tcal.ghz, step = REF_STEP_NS * tcal.ghz / REF_FINE;
+    m->power = 0;
+    for (int k = -REF_FINE; k <= REF_FINE; ++k) {
+        double p = refresh_power(sp, nscan, center + k * step, m->win);
+        if (p > m->power) { m->power = p; m->period = center + k * step; }
+    }
+
+    // 3. phase per window over the whole series
+    m->w0 = ts[0];
+    m->nwin = (size_t)((double)(ts[n - 1] - ts[0]) / m->win) + 1;
+    m->phase = (double *)calloc(m->nwin, sizeof(double));
+    if (!m->phase) { perror("calloc"); exit(1); }
+    double rsum = 0, prev = 0;
+    size_t weight = 0, i = 0;
+    for (size_t w = 0; w < m->nwin; ++w) {
+        double c = 0, s = 0, end = (double)(w + 1) * m->win;
+        size_t cnt = 0;
+        for (; i < m->nspikes && (double)(sp[i] - m->w0) < end; ++i, ++cnt) {
+            double th = 2 * M_PI * (double)(sp[i] - m->w0) / m->period;
+            c += cos(th);
+            s += sin(th);
+        }
+        if (cnt >= REF_WIN_SPIKES) {
+            prev = atan2(s, c) / (2 * M_PI);
+            rsum += sqrt(c * c + s * s);
+            weight += cnt;
+        }
+        m->phase[w] = prev;
+    }
+    m->coherence = weight ? rsum / (double)weight : 0;
+    m->detected = m->power >= REF_MIN_POWER && m->coherence >= REF_MIN_COHER;
+    if (!m->detected) { free(tmp); return -1; }
+
+    // 4. phase range of the in-phase spikes (central 95%, plus one median
+    //    latency since the stall also catches misses issued just before it)
+    double *ph = (double *)tmp;     // in place: sp[j] is read before ph[j] is written
+    size_t nph = 0;
+    for (size_t j = 0; j < m->nspikes; ++j) {
+        double p = refresh_phase(m, sp[j]);
+        if (fabs(p) <= 0.25) ph[nph++] = p;
+    }
+    qsort(ph, nph, sizeof(double), refresh_cmp_dbl);
+    double margin = (double)m->median / m->period;
+    m->win_lo = ph[nph * 25 / 1000] - margin;
+    m->win_hi = ph[nph * 975 / 1000] + margin;
+
+    // stall size and frequency over the flagged samples
+    double *ex = ph;
+    double last_k = -1;
+    size_t hit_periods = 0;
+    for (size_t j = 0; j < n; ++j) {
+        if (!refresh_affected(m, ts[j], lat[j])) continue;
+        ex[m->naffected++] = (double)(lat[j] - m->median);
+        m->stall_mean += (double)(lat[j] - m->median);
+        double t = (double)(ts[j] - m->w0) / m->period;
+        double k = floor(t - refresh_phase(m, ts[j]) + 0.5);  // index of that refresh
+        if (k != last_k) { ++hit_periods; last_k = k; }
+    }
+    if (m->naffected) {
+        m->stall_mean /= (double)m->naffected;
+        qsort(ex, m->naffected, sizeof(double), refresh_cmp_dbl);
+        m->trfc = ex[m->naffected * 95 / 100];
+    }
+    free(tmp);
+    double periods = (double)(ts[n - 1] - ts[0]) / m->period;
+    m->periods_hit = periods >= 1 ? (double)hit_periods / periods : 0;
+    return 0;
+}
+
+#endif // REFRESH_H
@@ -1,61 +1,60 @@
+#define _GNU_SOURCE
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <x86intrin.h>   
 #include <unistd.h>
 #include <sys/mman.h>
+#include "arena.h"
+#include "timer.h"       // tsc_cpuid_begin/tsc_cpuid_end, timer_net
 
 #define REPEAT 100000
 #define ROW_STRIDE (32*1024)   // row size = 32kB
-#define ALIGN     (64*1024)   // avoid physical mapping jitter
+#define ARENA_BYTES (64UL << 20)
 
 static inline void clflush_line(volatile void *p) {
     _mm_clflush(p);
     _mm_mfence();
 }
 
-static inline uint64_t rdtsc_begin(void) {
-    unsigned int eax, ebx, ecx, edx;
-    // serialize before
-    __asm__ volatile ("cpuid" : "=a"(eax), "=b"(ebx),
-                                  "=c"(ecx), "=d"(edx)
-                               : "a"(0) : "memory");
-    unsigned int aux;
-    _mm_lfence();
-    return __rdtscp(&aux);
-}
-
-static inline uint64_t rdtsc_end(void) {
-    unsigned int aux;
-    uint64_t t = __rdtscp(&aux);
-    _mm_lfence();
-    unsigned int eax, ebx, ecx, edx;
-    // serialize after
-    __asm__ volatile ("cpuid" : "=a"(eax), "=b"(ebx),
-                                  "=c"(ecx), "=d"(edx)
-                               : "a"(0) : "memory");
-    return t;
-}
-
-int main(void) {
+int main(int ac, char **av) {
     printf("===== Row Buffer Policy Test (serialized 2-access total) =====\n");
 
-    
+    // optional argv[1]: arena backing 4k|thp|2m|1g (default thp)
+    // optional argv[2]: idle gap in ns between the two accesses (default 0);
+    //                   it is spun inside the timed region and subtracted again
+    enum arena_backing backing = ARENA_THP;
+    if (ac > 1 && arena_parse_backing(av[1], &backing)) {
+        fprintf(stderr, "usage: %s [4k|thp|2m|1g] [gap_ns]\n", av[0]);
+        return 1;
+    }
+    double gap_ns = ac > 2 ? atof(av[2]) : 0;
+
     mlockall(MCL_CURRENT | MCL_FUTURE);
+    timer_init(1);
+    uint64_t gap = ns_ticks(gap_ns);
 
     
-    char *buf;
-    if (posix_memalign((void**)&buf, ALIGN, ALIGN * 4)) {
-        perror("posix_memalign");
+    struct arena ar;
+    if (arena_alloc(&ar, ARENA_BYTES, backing) && arena_alloc(&ar, ARENA_BYTES, ARENA_4K))
         return 1;
-    }
-    memset(buf, 0, ALIGN * 4);
+    char *buf = ar.base;
+    memset(buf, 0, ar.bytes);
 
     volatile unsigned long sink = 0; // avoid improvement
     char *addr1      = buf;
-    char *addr2_same = buf + 64;            // same row
-    char *addr2_diff = buf + ROW_STRIDE;    // different row
+    char *addr2_same = buf + 64;            // same row (same 4 KiB page => same frame)
+    // different row: ROW_STRIDE away in *physical* memory, not virtual
+    char *addr2_diff = arena_partner(&ar, addr1, ROW_STRIDE);
+    if (!addr2_diff) {
+        fprintf(stderr, "warning: no frame at +%d KB physical in arena, using virtual offset\n",
+                ROW_STRIDE / 1024);
+        addr2_diff = buf + ROW_STRIDE;
+    }
+    printf("arena: %s pages, addr1 pa=0x%" PRIx64 ", addr2_diff pa=0x%" PRIx64 "\n",
+           arena_backing_name[ar.kind], arena_pa(&ar, addr1), arena_pa(&ar, addr2_diff));
 
     // warm-up (TLB + page reside)
     sink += *addr1;
@@ -69,20 +68,21 @@ int main(void) {
         clflush_line(addr2_same);
 
         // time start
-        uint64_t t0 = rdtsc_begin();
+        uint64_t t0 = tsc_cpuid_begin();
 
         
         unsigned char v1 = *(volatile unsigned char*)addr1;
         
         _mm_lfence();
+        if (gap) tsc_delay(gap);
 
 
         const char *p2 = addr2_same + (v1 & 0);
         unsigned char v2 = *(volatile unsigned char*)p2;
 
         // time over
-        uint64_t t1 = rdtsc_end();
-        sum_same_total += (t1 - t0);
+        uint64_t t1 = tsc_cpuid_end();
+        sum_same_total += timer_net(TF_CPUID, t1 - t0 - gap);
 
         sink += v1 + v2;
     }
@@ -93,26 +93,30 @@ int main(void) {
         clflush_line(addr1);
         clflush_line(addr2_diff);
 
-        uint64_t t0 = rdtsc_begin();
+        uint64_t t0 = tsc_cpuid_begin();
 
         unsigned char v1 = *(volatile unsigned char*)addr1;
         _mm_lfence();
+        if (gap) tsc_delay(gap);
 
         const char *p2 = addr2_diff + (v1 & 0);
         unsigned char v2 = *(volatile unsigned char*)p2;
 
-        uint64_t t1 = rdtsc_end();
-        sum_diff_total += (t1 - t0);
+        uint64_t t1 = tsc_cpuid_end();
+        sum_diff_total += timer_net(TF_CPUID, t1 - t0 - gap);
 
         sink += v1 + v2;
     }
 
-    printf("Average over %d runs (ROW_STRIDE=%d KB):\n", REPEAT, (int)(ROW_STRIDE/1024));
-    printf("  Same-row total (2 accesses): %lu cycles\n", (unsigned long)(sum_same_total / REPEAT));
-    printf("  Diff-row total (2 accesses): %lu cycles\n", (unsigned long)(sum_diff_total / REPEAT));
+    printf("Average over %d runs (ROW_STRIDE=%d KB, idle gap %.0f ns), net of %" PRIu64
+           "-tick cpuid bracket:\n", REPEAT, (int)(ROW_STRIDE/1024), gap_ns, tcal.overhead[TF_CPUID]);
+    printf("  Same-row total (2 accesses): %lu cycles  %.1f ns\n", (unsigned long)(sum_same_total / REPEAT),
+           ticks_ns((double)sum_same_total / REPEAT));
+    printf("  Diff-row total (2 accesses): %lu cycles  %.1f ns\n", (unsigned long)(sum_diff_total / REPEAT),
+           ticks_ns((double)sum_diff_total / REPEAT));
 
     if (sink == 0xdeadbeef) puts("");
 
-    free(buf);
+    arena_free(&ar);
     return 0;
 }
\ No newline at end of file
@@ -1,72 +1,145 @@
+#define _GNU_SOURCE
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
+#include "arena.h"
+#include "timer.h"
+#include "refresh.h"
+#include "sampler.h"
 
-#define REPEAT 1000000
+#define REPEAT 1000000      // sample budget; sampling stops once the CIs converge
+#define MIN_SAMPLES 20000   // ~ms of row misses: enough refresh periods for refresh_detect
 #define ROW_SIZE 8192   // row size = 8 kB
 
 inline void clflush(volatile void *p) {
     asm volatile("clflush (%0)" :: "r"(p));
 }
 
-inline uint64_t rdtsc() {
-    unsigned long a, d;
-    asm volatile("rdtsc" : "=a"(a), "=d"(d));
-    return a | ((uint64_t)d << 32);
-}
-
 long int rep;
 
-void rowtest() {
+void rowtest(enum arena_backing backing, const struct sampler_cfg *cfg) {
     uint64_t start, end;
     uint64_t clock1 = 0, clock2 = 0, clock3 = 0;
 
-    char *buf;
-    if (posix_memalign((void**)&buf, ROW_SIZE, 2 * ROW_SIZE)) {
-        perror("posix_memalign");
+    // Arena instead of posix_memalign so row2 can be picked by physical address
+    struct arena ar;
+    if (arena_alloc(&ar, 4 << 20, backing) && arena_alloc(&ar, 4 << 20, ARENA_4K))
         exit(1);
-    }
 
-    char *row1 = buf;
-    char *row2 = buf + ROW_SIZE;
+    char *row1 = ar.base;
+    char *row2 = arena_partner(&ar, row1, ROW_SIZE);   // next row, physically
+    if (!row2 || row2 + ROW_SIZE > ar.base + ar.bytes) row2 = row1 + ROW_SIZE;   // a whole row must fit
+    printf("row1 pa=0x%" PRIx64 "  row2 pa=0x%" PRIx64 " (%s pages)\n",
+           arena_pa(&ar, row1), arena_pa(&ar, row2), arena_backing_name[ar.kind]);
 
     memset(row1, 'A', ROW_SIZE);
     memset(row2, 'B', ROW_SIZE);
 
+    // Sampling stops once row2's first access (the row-buffer miss) has a
+    // narrow CI; the sampler's budget caps the per-iteration arrays, kept so
+    // refresh-hit iterations can be told apart
+    struct sampler smp;
+    sampler_init(&smp, cfg);
+    size_t cap = smp.cfg.max_samples;
+    uint64_t *ts = (uint64_t *)xalloc(CACHELINE, cap * sizeof(uint64_t));
+    uint64_t *lat1 = (uint64_t *)xalloc(CACHELINE, cap * sizeof(uint64_t));
+    uint64_t *lat2 = (uint64_t *)xalloc(CACHELINE, cap * sizeof(uint64_t));
+    uint64_t *lat3 = (uint64_t *)xalloc(CACHELINE, cap * sizeof(uint64_t));
+    memset(ts, 0, cap * sizeof(uint64_t));
+    memset(lat1, 0, cap * sizeof(uint64_t));
+    memset(lat2, 0, cap * sizeof(uint64_t));
+    memset(lat3, 0, cap * sizeof(uint64_t));
+
     volatile char tmp;
 
-    for (rep = 0; rep < REPEAT; rep++) {
+    rep = 0;
+    do {
         // Step1: row1
-        start = rdtsc();
+        start = tsc_raw();
         tmp = row1[0];
-        end = rdtsc();
-        clock1 += (end - start);
+        end = tsc_raw();
+        ts[rep] = start;
+        lat1[rep] = timer_net(TF_RDTSC, end - start);
+        clock1 += lat1[rep];
 
         // Step2: row2（diff row）
-        start = rdtsc();
+        start = tsc_raw();
         tmp = row2[0];
-        end = rdtsc();
-        clock2 += (end - start);
+        end = tsc_raw();
+        lat2[rep] = timer_net(TF_RDTSC, end - start);
+        clock2 += lat2[rep];
+        sampler_add(&smp, lat2[rep]);
 
         // Step3: row2（same row again）
-        start = rdtsc();
+        start = tsc_raw();
         tmp = row2[64];
-        end = rdtsc();
-        clock3 += (end - start);
+        end = tsc_raw();
+        lat3[rep] = timer_net(TF_RDTSC, end - start);
+        clock3 += lat3[rep];
 
         clflush(row1);
         clflush(row2);
-    }
+        ++rep;
+    } while (!sampler_done(&smp));
 
     printf("===== Row Buffer Policy Test =====\n");
-    printf("Avg access row1: %" PRIu64 " cycles\n", clock1 / REPEAT);
-    printf("Avg access row2 (first): %" PRIu64 " cycles\n", clock2 / REPEAT);
-    printf("Avg access row2 (second): %" PRIu64 " cycles\n", clock3 / REPEAT);
+    printf("%s after %ld iterations\n", sampler_stop_name[smp.stop], rep);
+    printf("Avg access row1: %" PRIu64 " cycles  %.1f ns\n", clock1 / rep,
+           ticks_ns((double)clock1 / (double)rep));
+    printf("Avg access row2 (first): %" PRIu64 " cycles  %.1f ns\n", clock2 / rep,
+           ticks_ns((double)clock2 / (double)rep));
+    printf("Avg access row2 (second): %" PRIu64 " cycles  %.1f ns\n", clock3 / rep,
+           ticks_ns((double)clock3 / (double)rep));
+
+    // Refresh stalls show up as periodic spikes in row1's misses (refresh.h);
+    // an iteration is dropped if either first access was hit by one.
+    struct refresh_model m;
+    if (refresh_detect(ts, lat1, (size_t)rep, &m)) {
+        printf("no periodic refresh stall found in row1 (%zu spikes)\n", m.nspikes);
+    } else {
+        uint64_t c1 = 0, c2 = 0, c3 = 0;
+        long kept = 0;
+        for (long i = 0; i < rep; ++i) {
+            if (refresh_affected(&m, ts[i], lat1[i]) || refresh_affected(&m, ts[i] + lat1[i], lat2[i]))
+                continue;
+            c1 += lat1[i];
+            c2 += lat2[i];
+            c3 += lat3[i];
+            ++kept;
+        }
+        printf("refresh: period %.1f ns, tRFC ~%.0f ns, %ld of %ld iterations hit\n",
+               ticks_ns(m.period), ticks_ns(m.trfc), rep - kept, rep);
+        if (kept) {
+            printf("Avg access row1 (no refresh): %.1f ns\n", ticks_ns((double)c1 / kept));
+            printf("Avg access row2 (first, no refresh): %.1f ns\n", ticks_ns((double)c2 / kept));
+            printf("Avg access row2 (second, no refresh): %.1f ns\n", ticks_ns((double)c3 / kept));
+        }
+    }
+    refresh_free(&m);
+    free(ts);
+    free(lat1);
+    free(lat2);
+    free(lat3);
+    sampler_free(&smp);
+    arena_free(&ar);
 }
 
-int main() {
-    rowtest();
+int main(int ac, char **av) {
+    // optional: arena backing 4k|thp|2m|1g (default thp), sampler knobs
+    enum arena_backing backing = ARENA_THP;
+    struct sampler_cfg cfg = { .rel_width = 0.02, .want_p99 = 0, .min_samples = MIN_SAMPLES,
+                               .max_samples = REPEAT, .max_sec = 5.0 };
+    for (int i = 1; i < ac; ++i) {
+        if (!arena_parse_backing(av[i], &backing)) continue;
+        if (!sampler_parse_arg(&cfg, ac, av, &i)) {
+            fprintf(stderr, "usage: %s [4k|thp|2m|1g] [--ci W] [--min-samples N] "
+                            "[--max-samples N] [--max-sec S]\n", av[0]);
+            return 1;
+        }
+    }
+    timer_init(1);      // averages below are net of the rdtsc pair's own cost
+    rowtest(backing, &cfg);
     return 0;
 }
\ No newline at end of file
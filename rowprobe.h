@@ -0,0 +1,145 @@
+// rowprobe.h -- the A->B->A row-buffer timing from openrow_test.c.
+//
+// time_ABA() flushes both lines and times three loads, as before, but stops
+// once the median's confidence interval is within ABA_CI (sampler.h);
+// TRIALS is now only the cap. aba_once() is its single-sample body so
+// callers that want to decide how many samples to take (bankmap.c) can
+// drive it themselves, and time_ABA_n() keeps the fixed-count behaviour.
+//
+// With aba_pmu pointing at an open counter group (pmu.h), time_ABA() also
+// reads the counters just outside each sample's TSC window, keeps the
+// deltas per sample in aba_ctr_row[] and leaves their means in aba_ctr[]:
+// a row conflict should show up as one extra ACT per sample, a cache or
+// TLB effect as LLC / dTLB misses.
+//
+// time_gap() is the idle-gap variant: open A's row, stay idle for a given
+// number of ticks, then time a load of C in the same row. While the row is
+// still open that load is a row hit; once the controller's page-close
+// timer (or a refresh) has closed it, it costs an activate.
+//
+// Samples are net of the lfence/rdtscp/lfence bracket's own cost once
+// timer_init() has run (timer.h); before that they are raw ticks.
+#ifndef ROWPROBE_H
+#define ROWPROBE_H
+
+#include "bench.h"
+#include "sampler.h"
+#include "pmu.h"
+
+#ifndef TRIALS
+#define TRIALS 200          // per A->B->A timing (upper bound)
+#endif
+#define ABA_WARMUP 10
+#define ABA_CI     0.05     // target relative width of the median's 95% CI
+#define ABA_MIN    20
+
+// One A->B->A sample with both lines flushed to force DRAM accesses.
+static inline uint64_t aba_once(const char *A, const char *B) {
+    clflush_range((void*)A, CACHELINE);
+    clflush_range((void*)B, CACHELINE);
+    uint64_t t0 = tsc_now();
+    // Three dependent-ish loads (prevent reordering via volatile)
+    volatile char x;
+    x = *(volatile const char*)A;
+    x = *(volatile const char*)B;
+    x = *(volatile const char*)A;
+    (void)x;
+    uint64_t t1 = tsc_now();
+    return timer_net(TF_LFENCE, t1 - t0);
+}
+
+__attribute__((unused)) static struct pmu *aba_pmu;       // NULL: TSC only
+__attribute__((unused)) static uint64_t aba_ctr_row[TRIALS][PMU_NEVENTS];
+__attribute__((unused)) static double aba_ctr[PMU_NEVENTS];
+
+// aba_once() with the counter deltas of the sample written to `d`.
+static inline uint64_t aba_once_ctr(const char *A, const char *B, uint64_t *d) {
+    uint64_t c0[PMU_NEVENTS], c1[PMU_NEVENTS];
+    clflush_range((void*)A, CACHELINE);
+    clflush_range((void*)B, CACHELINE);
+    pmu_read(aba_pmu, c0);
+    uint64_t t0 = tsc_now();
+    volatile char x;
+    x = *(volatile const char*)A;
+    x = *(volatile const char*)B;
+    x = *(volatile const char*)A;
+    (void)x;
+    uint64_t t1 = tsc_now();
+    pmu_read(aba_pmu, c1);
+    pmu_delta(aba_pmu, c0, c1, d);
+    return timer_net(TF_LFENCE, t1 - t0);
+}
+
+// One idle-gap sample: A opens the row, `gap` ticks pass, C is timed.
+static inline uint64_t gap_once(const char *A, const char *C, uint64_t gap) {
+    clflush_range((void*)A, CACHELINE);
+    clflush_range((void*)C, CACHELINE);
+    (void)*(volatile const char*)A;
+    _mm_lfence();               // A's data has arrived: the row is open now
+    tsc_delay(gap);
+    uint64_t t0 = tsc_now();
+    (void)*(volatile const char*)C;
+    uint64_t t1 = tsc_now();
+    return timer_net(TF_LFENCE, t1 - t0);
+}
+
+static inline void aba_warmup(const char *A, const char *B) {
+    for (int i = 0; i < ABA_WARMUP; ++i) {
+        clflush_range((void*)A, CACHELINE);
+        clflush_range((void*)B, CACHELINE);
+        (void)*(volatile const char*)A;
+        (void)*(volatile const char*)B;
+        (void)*(volatile const char*)A;
+    }
+}
+
+// Median Δ of `trials` A->B->A samples (trials <= 1024).
+static inline uint64_t time_ABA_n(const char *A, const char *B, int trials) {
+    uint64_t t[1024];
+    if (trials > 1024) trials = 1024;
+    aba_warmup(A, B);
+    for (int r = 0; r < trials; ++r) t[r] = aba_once(A, B);
+    qsort(t, (size_t)trials, sizeof(uint64_t), cmp_u64);
+    return t[trials / 2];
+}
+
+// Measure Δ for A->B->A (loads) with flushes to force DRAM behavior.
+// Median of as many samples as it takes to converge, at most TRIALS.
+static inline uint64_t time_ABA(const char *A, const char *B) {
+    static struct sampler s;
+    if (!s.v) {
+        struct sampler_cfg cfg = { .rel_width = ABA_CI, .min_samples = ABA_MIN,
+                                   .max_samples = TRIALS, .max_sec = 0.1 };
+        sampler_init(&s, &cfg);
+    }
+    sampler_reset(&s);
+    aba_warmup(A, B);
+    if (!aba_pmu || !aba_pmu->n) {
+        do sampler_add(&s, aba_once(A, B)); while (!sampler_done(&s));
+        return s.median;
+    }
+    do sampler_add(&s, aba_once_ctr(A, B, aba_ctr_row[s.n])); while (!sampler_done(&s));
+    for (int c = 0; c < aba_pmu->n; ++c) {
+        double sum = 0;
+        for (uint64_t i = 0; i < s.n; ++i) sum += (double)aba_ctr_row[i][c];
+        aba_ctr[c] = sum / (double)s.n;
+    }
+    return s.median;
+}
+
+// Median latency of C after an idle gap of `gap_ns` following A.
+static inline uint64_t time_gap(const char *A, const char *C, double gap_ns) {
+    static struct sampler s;
+    if (!s.v) {
+        struct sampler_cfg cfg = { .rel_width = ABA_CI, .min_samples = ABA_MIN,
+                                   .max_samples = TRIALS, .max_sec = 0.1 };
+        sampler_init(&s, &cfg);
+    }
+    uint64_t gap = ns_ticks(gap_ns);
+    sampler_reset(&s);
+    aba_warmup(A, C);
+    do sampler_add(&s, gap_once(A, C, gap)); while (!sampler_done(&s));
+    return s.median;
+}
+
+#endif // ROWPROBE_H
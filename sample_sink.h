@@ -0,0 +1,288 @@
+// sample_sink.h -- in-memory sample sink for the timing harnesses.
+//
+// Replaces the per-sample fprintf() in memtest(): samples go into a
+// preallocated, page-locked ring and an online log-bucketed (HDR-style)
+// histogram. Nothing touches stdio while a size is being measured; the
+// summary, the binary dump and the optional CSV export are all written by
+// sink_finish() after the size is done.
+//
+// A harness that also reads hardware counters (pmu.h) attaches them with
+// sink_attach_counters() and records through sink_record_ctr(); the deltas
+// land in a parallel ring, their per-sample means are added to the summary,
+// and both exports carry them sample by sample.
+#ifndef SAMPLE_SINK_H
+#define SAMPLE_SINK_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+
+// Histogram layout: values below 2^SINK_SUB_BITS get one bucket each, every
+// power of two above that is split into 2^SINK_SUB_BITS linear sub-buckets,
+// so a bucket is never wider than 1/32 (~3%) of its value.
+#define SINK_SUB_BITS 5
+#define SINK_SUB      (1u << SINK_SUB_BITS)
+#define SINK_BUCKETS  ((64 - SINK_SUB_BITS + 1) * SINK_SUB)
+
+#define SINK_MAGIC   "SNK1"
+#define SINK_VERSION 2
+#define SINK_MAX_CTR 8
+#define SINK_CTR_NAME 16          // on-disk bytes per counter name
+
+struct sample_sink {
+    size_t    bytes;            // size label of the run in progress
+    uint64_t *ring;             // last `cap` samples, page-locked
+    size_t    cap;
+    size_t    head;             // next ring slot
+    uint64_t  n;                // samples recorded since sink_begin()
+    uint64_t  sum, min, max;
+    uint64_t  hist[SINK_BUCKETS];
+    unsigned  nctr;             // counter columns, 0 if none attached
+    const char *ctr_name[SINK_MAX_CTR];
+    uint64_t *ctr;              // cap x nctr deltas, same slots as `ring`
+    uint64_t  ctr_sum[SINK_MAX_CTR];
+};
+
+// Per-size summary computed by sink_finish().
+struct sink_stats {
+    uint64_t n, min, max;
+    double   mean;
+    uint64_t p50, p90, p99, p999;
+    int      exact;             // 1 if percentiles come from the full ring
+};
+
+// On-disk record header; followed by `nbuckets` uint32 bucket indices,
+// `nbuckets` uint64 counts and `kept` uint32 samples (sorted, saturated).
+// Version 2: if `nctr` > 0, then `nctr` names of SINK_CTR_NAME bytes and
+// `kept` rows of 1 + nctr uint64 (ticks, counter deltas) in recording order.
+struct sink_hdr {
+    char     magic[4];
+    uint32_t version;
+    uint64_t bytes, count, kept;
+    uint64_t min, max, p50, p90, p99, p999;
+    uint32_t sub_bits, nbuckets;
+    uint32_t nctr, reserved;
+};
+
+static inline unsigned sink_bucket(uint64_t v) {
+    if (v < SINK_SUB) return (unsigned)v;
+    unsigned k = 63u - (unsigned)__builtin_clzll(v);     // msb, >= SUB_BITS
+    unsigned sub = (unsigned)(v >> (k - SINK_SUB_BITS)) - SINK_SUB;
+    return ((k - SINK_SUB_BITS + 1) << SINK_SUB_BITS) + sub;
+}
+
+// Smallest value that lands in bucket `i` (inverse of sink_bucket).
+static inline uint64_t sink_bucket_lo(unsigned i) {
+    if (i < SINK_SUB) return i;
+    unsigned k = (i >> SINK_SUB_BITS) + SINK_SUB_BITS - 1;
+    uint64_t sub = i & (SINK_SUB - 1);
+    return (SINK_SUB + sub) << (k - SINK_SUB_BITS);
+}
+
+static inline void sink_init(struct sample_sink *s, size_t cap) {
+    memset(s, 0, sizeof(*s));
+    size_t len = cap * sizeof(uint64_t);
+    s->ring = (uint64_t *)mmap(NULL, len, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (s->ring == MAP_FAILED) { perror("mmap sample ring"); exit(1); }
+    if (mlock(s->ring, len))
+        perror("mlock sample ring (continuing unlocked)");
+    memset(s->ring, 0, len);    // make sure every page is resident
+    s->cap = cap;
+}
+
+// Adds `n` counter columns (n <= SINK_MAX_CTR); `names` must outlive the sink.
+static inline void sink_attach_counters(struct sample_sink *s, unsigned n, const char *const *names) {
+    if (n > SINK_MAX_CTR) n = SINK_MAX_CTR;
+    if (!n) return;
+    size_t len = s->cap * n * sizeof(uint64_t);
+    s->ctr = (uint64_t *)mmap(NULL, len, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (s->ctr == MAP_FAILED) { perror("mmap counter ring"); exit(1); }
+    if (mlock(s->ctr, len))
+        perror("mlock counter ring (continuing unlocked)");
+    memset(s->ctr, 0, len);
+    s->nctr = n;
+    for (unsigned i = 0; i < n; ++i) s->ctr_name[i] = names[i];
+}
+
+static inline void sink_free(struct sample_sink *s) {
+    munlock(s->ring, s->cap * sizeof(uint64_t));
+    munmap(s->ring, s->cap * sizeof(uint64_t));
+    s->ring = NULL;
+    if (s->ctr) {
+        munlock(s->ctr, s->cap * s->nctr * sizeof(uint64_t));
+        munmap(s->ctr, s->cap * s->nctr * sizeof(uint64_t));
+        s->ctr = NULL;
+    }
+}
+
+static inline void sink_begin(struct sample_sink *s, size_t bytes) {
+    s->bytes = bytes;
+    s->head = 0;
+    s->n = s->sum = s->max = 0;
+    s->min = UINT64_MAX;
+    memset(s->hist, 0, sizeof(s->hist));
+    memset(s->ctr_sum, 0, sizeof(s->ctr_sum));
+}
+
+// Hot path: one store into the ring and one histogram increment.
+static inline void sink_record(struct sample_sink *s, uint64_t v) {
+    s->ring[s->head] = v;
+    if (++s->head == s->cap) s->head = 0;
+    s->hist[sink_bucket(v)]++;
+    s->n++;
+    s->sum += v;
+    if (v < s->min) s->min = v;
+    if (v > s->max) s->max = v;
+}
+
+// Same, plus the counter deltas `d[0..nctr)` of this sample.
+static inline void sink_record_ctr(struct sample_sink *s, uint64_t v, const uint64_t *d) {
+    uint64_t *row = s->ctr + s->head * s->nctr;
+    for (unsigned i = 0; i < s->nctr; ++i) {
+        row[i] = d[i];
+        s->ctr_sum[i] += d[i];
+    }
+    sink_record(s, v);
+}
+
+// Prints the CSV header matching sink_finish()'s export.
+static inline void sink_csv_header(const struct sample_sink *s, FILE *csv) {
+    fprintf(csv, "Size(Bytes),Time(Ticks)");
+    for (unsigned i = 0; i < s->nctr; ++i) fprintf(csv, ",%s", s->ctr_name[i]);
+    fprintf(csv, "\n");
+}
+
+static int sink_cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Approximate quantile from the histogram (lower edge of the bucket).
+static uint64_t sink_hist_quantile(const struct sample_sink *s, double q) {
+    uint64_t rank = (uint64_t)(q * (double)(s->n - 1)), seen = 0;
+    for (unsigned i = 0; i < SINK_BUCKETS; ++i) {
+        seen += s->hist[i];
+        if (seen > rank) return sink_bucket_lo(i);
+    }
+    return s->max;
+}
+
+static inline size_t sink_kept(const struct sample_sink *s) {
+    return s->n < s->cap ? (size_t)s->n : s->cap;
+}
+
+// Computes the summary. Percentiles are exact whenever the ring still holds
+// every sample of the run; otherwise they fall back to the histogram. Sorts
+// the ring in place, so call it once per size, after the last sample.
+static void sink_stats(struct sample_sink *s, struct sink_stats *st) {
+    size_t kept = sink_kept(s);
+    memset(st, 0, sizeof(*st));
+    st->n = s->n;
+    if (!s->n) return;
+    st->min = s->min;
+    st->max = s->max;
+    st->mean = (double)s->sum / (double)s->n;
+    st->exact = (kept == s->n);
+    if (st->exact) {
+        qsort(s->ring, kept, sizeof(uint64_t), sink_cmp_u64);
+        st->p50  = s->ring[(kept - 1) * 50 / 100];
+        st->p90  = s->ring[(kept - 1) * 90 / 100];
+        st->p99  = s->ring[(kept - 1) * 99 / 100];
+        st->p999 = s->ring[(kept - 1) * 999 / 1000];
+    } else {
+        st->p50  = sink_hist_quantile(s, 0.50);
+        st->p90  = sink_hist_quantile(s, 0.90);
+        st->p99  = sink_hist_quantile(s, 0.99);
+        st->p999 = sink_hist_quantile(s, 0.999);
+    }
+}
+
+// `rows` is the (ticks, deltas...) table captured before sorting, or NULL.
+static void sink_write_bin(const struct sample_sink *s, const struct sink_stats *st,
+                           const uint64_t *rows, FILE *bin) {
+    struct sink_hdr h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SINK_MAGIC, 4);
+    h.version = SINK_VERSION;
+    h.bytes = s->bytes;
+    h.count = s->n;
+    h.kept = sink_kept(s);
+    h.min = st->min; h.max = st->max;
+    h.p50 = st->p50; h.p90 = st->p90; h.p99 = st->p99; h.p999 = st->p999;
+    h.sub_bits = SINK_SUB_BITS;
+    h.nctr = rows ? s->nctr : 0;
+
+    uint32_t idx[SINK_BUCKETS];
+    uint64_t cnt[SINK_BUCKETS];
+    for (unsigned i = 0; i < SINK_BUCKETS; ++i) {
+        if (!s->hist[i]) continue;
+        idx[h.nbuckets] = i;
+        cnt[h.nbuckets] = s->hist[i];
+        h.nbuckets++;
+    }
+    fwrite(&h, sizeof(h), 1, bin);
+    fwrite(idx, sizeof(uint32_t), h.nbuckets, bin);
+    fwrite(cnt, sizeof(uint64_t), h.nbuckets, bin);
+
+    uint32_t chunk[1024];
+    for (size_t i = 0; i < h.kept; ) {
+        size_t m = 0;
+        for (; m < 1024 && i < h.kept; ++m, ++i)
+            chunk[m] = s->ring[i] > UINT32_MAX ? UINT32_MAX : (uint32_t)s->ring[i];
+        fwrite(chunk, sizeof(uint32_t), m, bin);
+    }
+    if (h.nctr) {
+        char name[SINK_CTR_NAME];
+        for (unsigned i = 0; i < h.nctr; ++i) {
+            memset(name, 0, sizeof(name));
+            strncpy(name, s->ctr_name[i], sizeof(name) - 1);
+            fwrite(name, 1, sizeof(name), bin);
+        }
+        fwrite(rows, sizeof(uint64_t), h.kept * (1 + h.nctr), bin);
+    }
+}
+
+// Ends the current size: prints a one-line summary, appends a binary record
+// to `bin` and, if `csv` is non-NULL, exports the kept samples in the old
+// "Size(Bytes),Time(Ticks)" format. Either file may be NULL.
+static inline void sink_finish(struct sample_sink *s, FILE *bin, FILE *csv) {
+    struct sink_stats st;
+    size_t kept = sink_kept(s);
+    if (csv) {  // before sink_stats() sorts the ring, to keep sample order
+        for (size_t i = 0; i < kept; ++i) {
+            fprintf(csv, "%zu,%" PRIu64, s->bytes, s->ring[i]);
+            for (unsigned c = 0; c < s->nctr; ++c)
+                fprintf(csv, ",%" PRIu64, s->ctr[i * s->nctr + c]);
+            fprintf(csv, "\n");
+        }
+    }
+    uint64_t *rows = NULL;      // likewise, keep ticks paired with their deltas
+    if (bin && s->nctr && kept) {
+        rows = (uint64_t *)malloc(kept * (1 + s->nctr) * sizeof(uint64_t));
+        if (!rows) { perror("malloc"); exit(1); }
+        for (size_t i = 0; i < kept; ++i) {
+            rows[i * (1 + s->nctr)] = s->ring[i];
+            memcpy(rows + i * (1 + s->nctr) + 1, s->ctr + i * s->nctr, s->nctr * sizeof(uint64_t));
+        }
+    }
+    sink_stats(s, &st);
+    printf("%8zu B  n=%-8" PRIu64 " mean=%-9.1f p50=%-7" PRIu64 " p90=%-7" PRIu64
+           " p99=%-7" PRIu64 " p99.9=%-7" PRIu64 " max=%" PRIu64 "%s\n",
+           s->bytes, st.n, st.mean, st.p50, st.p90, st.p99, st.p999, st.max,
+           st.exact ? "" : "  (hist)");
+    if (s->nctr && s->n) {
+        printf("          per sample:");
+        for (unsigned c = 0; c < s->nctr; ++c)
+            printf(" %s=%.1f", s->ctr_name[c], (double)s->ctr_sum[c] / (double)s->n);
+        printf("\n");
+    }
+    if (bin) sink_write_bin(s, &st, rows, bin);
+    free(rows);
+}
+
+#endif // SAMPLE_SINK_H
@@ -0,0 +1,135 @@
+// sampler.h -- confidence-driven sample counts instead of fixed REPEAT/TRIALS.
+//
+// The harness keeps calling sampler_add() until sampler_done() says the
+// median (and optionally p99) is pinned down: the distribution-free 95%
+// confidence interval of each quantile, taken from order statistics, must
+// be narrower than `rel_width` times the quantile itself. Time and sample
+// budgets cap the run when the distribution never settles.
+//
+//   struct sampler s;
+//   sampler_init(&s, &cfg);
+//   do { ...time one sample...; sampler_add(&s, t1 - t0); } while (!sampler_done(&s));
+//
+// The convergence check sorts a scratch copy, so it runs on a geometric
+// schedule (every ~25% more samples) and never inside a timed region.
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+struct sampler_cfg {
+    double   rel_width;     // target CI width / quantile, e.g. 0.02
+    int      want_p99;      // also require the p99 CI to converge
+    uint64_t min_samples;
+    uint64_t max_samples;
+    double   max_sec;       // wall-clock budget
+};
+
+enum sampler_stop { SAMPLER_RUNNING, SAMPLER_CONVERGED, SAMPLER_MAX_SAMPLES, SAMPLER_MAX_TIME };
+
+__attribute__((unused))
+static const char *sampler_stop_name[] = { "running", "converged", "sample budget", "time budget" };
+
+struct sampler {
+    struct sampler_cfg cfg;
+    uint64_t *v, *scratch;
+    uint64_t  n, next_check;
+    double    t0;
+    enum sampler_stop stop;
+    double    med_width, p99_width;   // relative CI widths at the last check
+    uint64_t  median, p99;
+};
+
+static inline double sampler_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+// Restart for the next size/pair, keeping the buffers.
+static inline void sampler_reset(struct sampler *s) {
+    s->n = 0;
+    s->next_check = s->cfg.min_samples;
+    s->stop = SAMPLER_RUNNING;
+    s->med_width = s->p99_width = INFINITY;
+    s->t0 = sampler_now();
+}
+
+static inline void sampler_init(struct sampler *s, const struct sampler_cfg *cfg) {
+    memset(s, 0, sizeof(*s));
+    s->cfg = *cfg;
+    if (s->cfg.min_samples < 10) s->cfg.min_samples = 10;
+    if (s->cfg.max_samples < s->cfg.min_samples) s->cfg.max_samples = s->cfg.min_samples;
+    s->v = (uint64_t *)malloc(s->cfg.max_samples * sizeof(uint64_t));
+    s->scratch = (uint64_t *)malloc(s->cfg.max_samples * sizeof(uint64_t));
+    if (!s->v || !s->scratch) { perror("sampler malloc"); exit(1); }
+    sampler_reset(s);
+}
+
+static inline void sampler_free(struct sampler *s) {
+    free(s->v);
+    free(s->scratch);
+    s->v = s->scratch = NULL;
+}
+
+static inline void sampler_add(struct sampler *s, uint64_t x) {
+    if (s->n < s->cfg.max_samples) s->v[s->n++] = x;
+}
+
+static int sampler_cmp(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Relative width of the 95% order-statistic CI of quantile q over sorted
+// x[0..n); INFINITY if n is too small for the upper rank to exist. A zero
+// estimate (a net time below the timer's own overhead) counts as pinned
+// down, width 0, only if the whole interval is zero as well.
+static inline double sampler_ci(const uint64_t *x, uint64_t n, double q, uint64_t *est) {
+    *est = 0;
+    if (!n) return INFINITY;
+    double c = 1.96 * sqrt((double)n * q * (1 - q));
+    double lo = floor((double)n * q - c), hi = ceil((double)n * q + c);
+    *est = x[(uint64_t)((double)(n - 1) * q)];
+    if (lo < 0 || hi >= (double)n) return INFINITY;
+    if (*est == 0) return x[(uint64_t)hi] == x[(uint64_t)lo] ? 0 : INFINITY;
+    return (double)(x[(uint64_t)hi] - x[(uint64_t)lo]) / (double)*est;
+}
+
+// Re-evaluates the stop rule; cheap except at scheduled checkpoints.
+static inline int sampler_done(struct sampler *s) {
+    if (s->stop != SAMPLER_RUNNING) return 1;
+    if (s->n >= s->cfg.max_samples) s->stop = SAMPLER_MAX_SAMPLES;
+    else if ((s->n & 63) == 0 && sampler_now() - s->t0 > s->cfg.max_sec)
+        s->stop = SAMPLER_MAX_TIME;
+    else if (s->n < s->next_check) return 0;
+
+    memcpy(s->scratch, s->v, s->n * sizeof(uint64_t));
+    qsort(s->scratch, s->n, sizeof(uint64_t), sampler_cmp);
+    s->med_width = sampler_ci(s->scratch, s->n, 0.50, &s->median);
+    s->p99_width = sampler_ci(s->scratch, s->n, 0.99, &s->p99);
+    if (s->stop == SAMPLER_RUNNING && s->med_width <= s->cfg.rel_width &&
+        (!s->cfg.want_p99 || s->p99_width <= s->cfg.rel_width))
+        s->stop = SAMPLER_CONVERGED;
+    s->next_check = s->n + s->n / 4 + 1;
+    return s->stop != SAMPLER_RUNNING;
+}
+
+// Parses the shared command-line knobs; returns 1 if av[*i] was consumed.
+//   --ci W  --min-samples N  --max-samples N  --max-sec S
+static inline int sampler_parse_arg(struct sampler_cfg *cfg, int ac, char **av, int *i) {
+    if (*i + 1 >= ac) return 0;
+    if (!strcmp(av[*i], "--ci"))               cfg->rel_width = atof(av[++*i]);
+    else if (!strcmp(av[*i], "--min-samples")) cfg->min_samples = strtoull(av[++*i], NULL, 0);
+    else if (!strcmp(av[*i], "--max-samples")) cfg->max_samples = strtoull(av[++*i], NULL, 0);
+    else if (!strcmp(av[*i], "--max-sec"))     cfg->max_sec = atof(av[++*i]);
+    else return 0;
+    return 1;
+}
+
+#endif // SAMPLER_H
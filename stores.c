@@ -0,0 +1,206 @@
+// stores.c -- the write path: RFO stores, streaming stores, write-back, drain.
+//
+// rowmap.c and rowtest.c time a single store with rdtsc, which only
+// measures the store entering the store buffer. For every working-set size
+// (4 KiB .. -M MiB, octave steps) and access pattern (seq: lines in
+// address order, rand: a random line order) this reports:
+//   store   GB/s of full-line regular stores; each line is first read for
+//           ownership, so DRAM sees ~2x the bytes once the set leaves the LLC
+//   nt      GB/s of movntdq full-line streaming stores + one sfence per pass
+//   clwb    ns per line to write back a just-written line (clwb + sfence)
+//   flopt   same with clflushopt (write back and invalidate)
+//   sfence  median latency of one 8-byte store + sfence
+//   mfence  median latency of one 8-byte store + mfence; mfence waits for
+//           the store buffer to drain, so this includes the RFO miss
+// and, per pattern, the smallest size from which nt beats store -- where
+// streaming stores start to pay off. clwb/clflushopt fall back to clflush
+// on CPUs without them (marked in the header line).
+//
+// usage: ./stores [-M max_MiB] [-p 4k|thp|2m|1g] [-o stores.csv]
+#define _GNU_SOURCE
+#include <unistd.h>
+#include "bench.h"
+#include "arena.h"
+#include "chase.h"
+#include "copy_kernels.h"
+
+#define MIN_KB       4
+#define MIN_SEC      0.05       // per bandwidth point
+#define WB_PASSES    8          // write-back: timed passes per point
+#define LAT_SAMPLES  2001
+#define MAX_SIZES    32
+
+enum pattern { PAT_SEQ, PAT_RAND, NPATTERNS };
+static const char *pattern_name[NPATTERNS] = { "seq", "rand" };
+
+struct row {
+    double store, nt, clwb, flopt, sfence, mfence;
+};
+
+static void store_pass(char *base, const uint32_t *idx, size_t n) {
+    __m128i v = _mm_set1_epi8(0x5A);
+    for (size_t i = 0; i < n; ++i) {
+        __m128i *p = (__m128i *)(base + (size_t)idx[i] * CACHELINE);
+        _mm_store_si128(p, v);
+        _mm_store_si128(p + 1, v);
+        _mm_store_si128(p + 2, v);
+        _mm_store_si128(p + 3, v);
+    }
+    asm volatile("" ::: "memory");
+}
+
+static void nt_pass(char *base, const uint32_t *idx, size_t n) {
+    __m128i v = _mm_set1_epi8(0x5A);
+    for (size_t i = 0; i < n; ++i) {
+        __m128i *p = (__m128i *)(base + (size_t)idx[i] * CACHELINE);
+        _mm_stream_si128(p, v);
+        _mm_stream_si128(p + 1, v);
+        _mm_stream_si128(p + 2, v);
+        _mm_stream_si128(p + 3, v);
+    }
+    _mm_sfence();
+}
+
+__attribute__((target("clwb")))
+static void clwb_pass(char *base, const uint32_t *idx, size_t n) {
+    for (size_t i = 0; i < n; ++i) _mm_clwb(base + (size_t)idx[i] * CACHELINE);
+    _mm_sfence();
+}
+
+__attribute__((target("clflushopt")))
+static void clflushopt_pass(char *base, const uint32_t *idx, size_t n) {
+    for (size_t i = 0; i < n; ++i) _mm_clflushopt(base + (size_t)idx[i] * CACHELINE);
+    _mm_sfence();
+}
+
+static void clflush_pass(char *base, const uint32_t *idx, size_t n) {
+    for (size_t i = 0; i < n; ++i) _mm_clflush(base + (size_t)idx[i] * CACHELINE);
+    _mm_mfence();
+}
+
+typedef void (*pass_fn)(char *, const uint32_t *, size_t);
+
+// GB/s of `fn`, repeated until MIN_SEC has passed.
+static double bandwidth(pass_fn fn, char *base, const uint32_t *idx, size_t n) {
+    fn(base, idx, n);                                   // warm TLB / path
+    long passes = 0;
+    double t0 = now_sec(), t1;
+    do { fn(base, idx, n); ++passes; } while ((t1 = now_sec()) - t0 < MIN_SEC);
+    return (double)passes * (double)n * CACHELINE / (t1 - t0) / 1e9;
+}
+
+// ns per line of the write-back pass `wb` right after a regular store pass.
+static double writeback(pass_fn wb, char *base, const uint32_t *idx, size_t n) {
+    uint64_t ticks = 0;
+    for (int r = 0; r < WB_PASSES; ++r) {
+        store_pass(base, idx, n);
+        uint64_t t0 = tsc_begin();
+        wb(base, idx, n);
+        uint64_t t1 = tsc_end();
+        ticks += timer_net(TF_RDTSCP, t1 - t0);
+    }
+    return ticks_ns((double)ticks / WB_PASSES / (double)n);
+}
+
+// Median ns of one 8-byte store drained by sfence (mfence = 0) or mfence,
+// walking the set in `idx` order so the line's temperature follows the size.
+static double store_latency(int mfence, char *base, const uint32_t *idx, size_t n) {
+    static uint64_t t[LAT_SAMPLES];
+    size_t j = 0;
+    for (int i = 0; i < LAT_SAMPLES; ++i) {
+        volatile uint64_t *p = (volatile uint64_t *)(base + (size_t)idx[j] * CACHELINE);
+        if (++j == n) j = 0;
+        uint64_t t0 = tsc_begin();
+        *p = (uint64_t)i;
+        if (mfence) _mm_mfence(); else _mm_sfence();
+        uint64_t t1 = tsc_end();
+        t[i] = timer_net(TF_RDTSCP, t1 - t0);
+    }
+    qsort(t, LAT_SAMPLES, sizeof(uint64_t), cmp_u64);
+    return ticks_ns((double)t[LAT_SAMPLES / 2]);
+}
+
+int main(int ac, char **av) {
+    size_t max_mb = 256;
+    enum arena_backing backing = ARENA_THP;
+    const char *out_path = "stores.csv";
+    int opt;
+    while ((opt = getopt(ac, av, "M:p:o:")) != -1) {
+        switch (opt) {
+        case 'M': max_mb = (size_t)atol(optarg); break;
+        case 'p': if (arena_parse_backing(optarg, &backing)) goto usage; break;
+        case 'o': out_path = optarg; break;
+        default:  goto usage;
+        }
+    }
+
+    copy_kernels_init();
+    timer_init(1);
+    pass_fn wb_clwb = cpu_feat.clwb ? clwb_pass : clflush_pass;
+    pass_fn wb_flopt = cpu_feat.clflushopt ? clflushopt_pass : clflush_pass;
+
+    struct arena ar;
+    if (arena_alloc(&ar, max_mb << 20, backing)) return 1;
+    memset(ar.base, 0, ar.bytes);
+    size_t max_lines = ar.bytes / CACHELINE;
+    uint32_t *idx = (uint32_t *)xalloc(CACHELINE, max_lines * sizeof(uint32_t));
+
+    FILE *out = fopen(out_path, "w");
+    if (!out) { perror(out_path); return 1; }
+    fprintf(out, "Size(Bytes),Pattern,StoreGBps,NtGBps,ClwbNsPerLine,ClflushoptNsPerLine,"
+                 "SfenceLatNs,MfenceLatNs\n");
+    printf("%s pages; clwb %s, clflushopt %s\n", arena_backing_name[ar.kind],
+           cpu_feat.clwb ? "yes" : "no (clflush)", cpu_feat.clflushopt ? "yes" : "no (clflush)");
+    printf("%10s %5s %9s %9s %9s %9s %9s %9s\n", "size", "pat", "store", "nt",
+           "clwb", "flopt", "sfence", "mfence");
+    printf("%10s %5s %9s %9s %9s %9s %9s %9s\n", "", "", "GB/s", "GB/s",
+           "ns/line", "ns/line", "ns", "ns");
+
+    static struct row res[NPATTERNS][MAX_SIZES];
+    size_t sizes[MAX_SIZES];
+    int nsizes = 0;
+    for (size_t bytes = (size_t)MIN_KB << 10; bytes <= ar.bytes && nsizes < MAX_SIZES; bytes <<= 1) {
+        size_t n = bytes / CACHELINE;
+        sizes[nsizes] = bytes;
+        for (int pat = 0; pat < NPATTERNS; ++pat) {
+            if (pat == PAT_SEQ) for (size_t i = 0; i < n; ++i) idx[i] = (uint32_t)i;
+            else chase_cycle(idx, n);          // any random order will do
+            struct row *r = &res[pat][nsizes];
+            r->store  = bandwidth(store_pass, ar.base, idx, n);
+            r->nt     = bandwidth(nt_pass, ar.base, idx, n);
+            r->clwb   = writeback(wb_clwb, ar.base, idx, n);
+            r->flopt  = writeback(wb_flopt, ar.base, idx, n);
+            store_pass(ar.base, idx, n);
+            r->sfence = store_latency(0, ar.base, idx, n);
+            r->mfence = store_latency(1, ar.base, idx, n);
+            printf("%10zu %5s %9.2f %9.2f %9.2f %9.2f %9.1f %9.1f\n", bytes, pattern_name[pat],
+                   r->store, r->nt, r->clwb, r->flopt, r->sfence, r->mfence);
+            fprintf(out, "%zu,%s,%.3f,%.3f,%.3f,%.3f,%.2f,%.2f\n", bytes, pattern_name[pat],
+                    r->store, r->nt, r->clwb, r->flopt, r->sfence, r->mfence);
+            fflush(stdout);
+        }
+        ++nsizes;
+    }
+
+    printf("\n");
+    for (int pat = 0; pat < NPATTERNS; ++pat) {
+        int from = -1;                  // nt wins from here to the largest size
+        for (int i = nsizes - 1; i >= 0 && res[pat][i].nt >= res[pat][i].store; --i) from = i;
+        if (from < 0)
+            printf("  %-4s: regular stores win at every size up to %zu MiB\n",
+                   pattern_name[pat], sizes[nsizes - 1] >> 20);
+        else
+            printf("  %-4s: streaming stores pay off from %zu KiB (%.2f vs %.2f GB/s there)\n",
+                   pattern_name[pat], sizes[from] >> 10, res[pat][from].nt, res[pat][from].store);
+    }
+    printf("wrote %s\n", out_path);
+
+    fclose(out);
+    free(idx);
+    arena_free(&ar);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-M max_MiB] [-p 4k|thp|2m|1g] [-o stores.csv]\n", av[0]);
+    return 1;
+}
@@ -0,0 +1,184 @@
+// timer.h -- TSC reads, their overhead, and ticks -> ns.
+//
+// The harnesses grew four ways of bracketing a region with the TSC:
+//
+//   TF_RDTSC   rdtsc ... rdtsc                      hw1.c, rowalign.c
+//   TF_RDTSCP  lfence;rdtscp ... rdtscp;lfence      hw1_test.c (tsc_begin/tsc_end)
+//   TF_LFENCE  lfence;rdtscp;lfence (both ends)     openrow_test.c (tsc_now)
+//   TF_CPUID   cpuid;lfence;rdtscp ... rdtscp;lfence;cpuid   row_total.c
+//
+// They stay separate -- each program keeps the ordering it was written
+// for -- but they now live here, and timer_init() measures what an empty
+// region costs with each of them (median of TIMER_CAL_SAMPLES), so callers
+// can report net ticks with timer_net(). cpuid alone is 100+ cycles on many
+// parts, more than the row-hit/row-miss difference being measured.
+//
+// timer_init() also checks for an invariant TSC (CPUID 0x80000007 EDX[8])
+// and measures its rate against CLOCK_MONOTONIC_RAW, so ticks can be
+// printed as ns (ticks_ns) next to the raw counts.
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <time.h>
+#include <cpuid.h>
+#include <x86intrin.h>   // _mm_lfence, __rdtsc, __rdtscp
+
+#define TIMER_CAL_SAMPLES 10001
+#define TIMER_CAL_SEC     0.02    // per frequency measurement
+#define TIMER_CAL_ROUNDS  5
+
+enum timer_fence { TF_RDTSC, TF_RDTSCP, TF_LFENCE, TF_CPUID, TF_NSTYLES };
+
+__attribute__((unused))
+static const char *timer_fence_name[TF_NSTYLES] = {
+    "rdtsc", "lfence+rdtscp", "lfence/rdtscp/lfence", "cpuid+rdtscp"
+};
+
+struct timer_cal {
+    int      done;
+    int      invariant;                 // CPUID says the TSC rate is constant
+    double   ghz;                       // measured ticks per ns
+    uint64_t overhead[TF_NSTYLES];      // empty-region median, ticks
+};
+
+__attribute__((unused)) static struct timer_cal tcal;
+
+static inline double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+// TF_RDTSC: unordered; loads may move across it.
+static inline uint64_t tsc_raw(void) {
+    return __rdtsc();
+}
+
+// TF_RDTSCP
+static inline uint64_t tsc_begin(void) {
+    unsigned int aux;
+    _mm_lfence();                // serialize before reading TSC
+    return __rdtscp(&aux);
+}
+
+static inline uint64_t tsc_end(void) {
+    unsigned int aux;
+    uint64_t t = __rdtscp(&aux);
+    _mm_lfence();                // keep later work out of the region
+    return t;
+}
+
+// TF_LFENCE: the same read at both ends of the region.
+static inline uint64_t tsc_now(void) {
+    unsigned aux;
+    _mm_lfence();
+    uint64_t t = __rdtscp(&aux);
+    _mm_lfence();
+    return t;
+}
+
+static inline void cpuid_serialize(void) {
+    unsigned int eax = 0, ebx, ecx, edx;
+    __asm__ volatile ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) :: "memory");
+}
+
+// TF_CPUID
+static inline uint64_t tsc_cpuid_begin(void) {
+    cpuid_serialize();
+    return tsc_begin();
+}
+
+static inline uint64_t tsc_cpuid_end(void) {
+    uint64_t t = tsc_end();
+    cpuid_serialize();
+    return t;
+}
+
+static inline int timer_cmp(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static inline uint64_t timer_empty(enum timer_fence f) {
+    uint64_t t0, t1;
+    switch (f) {
+    case TF_RDTSC:  t0 = tsc_raw();         t1 = tsc_raw();       break;
+    case TF_RDTSCP: t0 = tsc_begin();       t1 = tsc_end();       break;
+    case TF_LFENCE: t0 = tsc_now();         t1 = tsc_now();       break;
+    default:        t0 = tsc_cpuid_begin(); t1 = tsc_cpuid_end(); break;
+    }
+    return t1 - t0;
+}
+
+static inline int tsc_invariant(void) {
+    unsigned int a, b, c, d;
+    if (!__get_cpuid(0x80000000, &a, &b, &c, &d) || a < 0x80000007) return 0;
+    __get_cpuid(0x80000007, &a, &b, &c, &d);
+    return (d >> 8) & 1;
+}
+
+// Calibrates once per process; prints a one-line summary if `print`.
+static inline void timer_init(int print) {
+    if (tcal.done) return;
+    tcal.invariant = tsc_invariant();
+
+    double ghz[TIMER_CAL_ROUNDS];
+    for (int r = 0; r < TIMER_CAL_ROUNDS; ++r) {
+        double s0 = now_sec();
+        uint64_t c0 = tsc_now();
+        double s1;
+        do s1 = now_sec(); while (s1 - s0 < TIMER_CAL_SEC);
+        uint64_t c1 = tsc_now();
+        ghz[r] = (double)(c1 - c0) / ((s1 - s0) * 1e9);
+    }
+    for (int i = 1; i < TIMER_CAL_ROUNDS; ++i)        // median of a handful
+        for (int j = i; j > 0 && ghz[j] < ghz[j - 1]; --j) {
+            double t = ghz[j]; ghz[j] = ghz[j - 1]; ghz[j - 1] = t;
+        }
+    tcal.ghz = ghz[TIMER_CAL_ROUNDS / 2];
+
+    uint64_t *v = (uint64_t *)malloc(TIMER_CAL_SAMPLES * sizeof(uint64_t));
+    if (!v) { perror("malloc"); exit(1); }
+    for (int f = 0; f < TF_NSTYLES; ++f) {
+        for (int i = 0; i < 100; ++i) (void)timer_empty((enum timer_fence)f);
+        for (int i = 0; i < TIMER_CAL_SAMPLES; ++i) v[i] = timer_empty((enum timer_fence)f);
+        qsort(v, TIMER_CAL_SAMPLES, sizeof(uint64_t), timer_cmp);
+        tcal.overhead[f] = v[TIMER_CAL_SAMPLES / 2];
+    }
+    free(v);
+    tcal.done = 1;
+
+    if (print) {
+        printf("tsc: %.3f GHz%s; empty region:", tcal.ghz,
+               tcal.invariant ? ", invariant" : ", NOT invariant (ns figures are approximate)");
+        for (int f = 0; f < TF_NSTYLES; ++f)
+            printf(" %s=%" PRIu64, timer_fence_name[f], tcal.overhead[f]);
+        printf(" ticks\n");
+    }
+}
+
+// Ticks with the fence style's own cost removed (0 if below it).
+static inline uint64_t timer_net(enum timer_fence f, uint64_t ticks) {
+    uint64_t o = tcal.overhead[f];
+    return ticks > o ? ticks - o : 0;
+}
+
+static inline double ticks_ns(double ticks) {
+    return tcal.ghz > 0 ? ticks / tcal.ghz : 0;
+}
+
+static inline uint64_t ns_ticks(double ns) {
+    return (uint64_t)(ns * tcal.ghz + 0.5);
+}
+
+// Busy-waits `ticks` TSC ticks without touching memory.
+static inline void tsc_delay(uint64_t ticks) {
+    uint64_t t0 = __rdtsc();
+    while (__rdtsc() - t0 < ticks) _mm_pause();
+}
+
+#endif // TIMER_H
@@ -0,0 +1,74 @@
+// topo.h -- CPU topology from sysfs, for placing threads relative to each other.
+//
+// For each CPU we read from /sys/devices/system/cpu/cpuN:
+//   core   first CPU of topology/thread_siblings_list (SMT siblings share it)
+//   llc    first CPU of the last-level cache's shared_cpu_list (a CCX on
+//          AMD, the whole socket on most Intel parts)
+//   die    topology/die_id (a CCD on AMD, 0 where the kernel has no dies)
+//   pkg    topology/physical_package_id (socket)
+// and topo_relation() names the closest level two CPUs share. A file the
+// kernel does not export falls back to "CPU is alone at that level" for
+// core and llc and to 0 for die and pkg.
+#ifndef TOPO_H
+#define TOPO_H
+
+#include "bench.h"
+
+#define TOPO_SYSFS "/sys/devices/system/cpu"
+
+struct cpu_topo {
+    int cpu, core, llc, die, pkg;
+    int llc_level;              // cache level `llc` was read from, 0 if none
+    int llc_ways, llc_sets;     // as the kernel reports them (CPUID leaf 4), 0 if not
+};
+
+enum topo_rel { REL_SELF, REL_SMT, REL_LLC, REL_DIE, REL_PKG, REL_REMOTE, NREL };
+__attribute__((unused))
+static const char *topo_rel_name[NREL] = { "self", "smt", "same-llc", "same-die", "same-pkg", "cross-pkg" };
+
+// First number in a sysfs file (an int or a cpu list), or `dflt`.
+static inline int topo_read_first(const char *path, int dflt) {
+    FILE *f = fopen(path, "r");
+    int v;
+    if (!f) return dflt;
+    if (fscanf(f, "%d", &v) != 1) v = dflt;
+    fclose(f);
+    return v;
+}
+
+static inline void topo_get(int cpu, struct cpu_topo *t) {
+    char path[160];
+    t->cpu = cpu;
+    snprintf(path, sizeof(path), TOPO_SYSFS "/cpu%d/topology/thread_siblings_list", cpu);
+    t->core = topo_read_first(path, cpu);
+    snprintf(path, sizeof(path), TOPO_SYSFS "/cpu%d/topology/die_id", cpu);
+    t->die = topo_read_first(path, 0);
+    snprintf(path, sizeof(path), TOPO_SYSFS "/cpu%d/topology/physical_package_id", cpu);
+    t->pkg = topo_read_first(path, 0);
+    t->llc = cpu;
+    t->llc_level = t->llc_ways = t->llc_sets = 0;
+    for (int i = 0; i < 8; ++i) {           // highest unified/data level wins
+        snprintf(path, sizeof(path), TOPO_SYSFS "/cpu%d/cache/index%d/level", cpu, i);
+        int level = topo_read_first(path, -1);
+        if (level < 0) break;
+        if (level <= t->llc_level) continue;
+        snprintf(path, sizeof(path), TOPO_SYSFS "/cpu%d/cache/index%d/shared_cpu_list", cpu, i);
+        t->llc = topo_read_first(path, cpu);
+        t->llc_level = level;
+        snprintf(path, sizeof(path), TOPO_SYSFS "/cpu%d/cache/index%d/ways_of_associativity", cpu, i);
+        t->llc_ways = topo_read_first(path, 0);
+        snprintf(path, sizeof(path), TOPO_SYSFS "/cpu%d/cache/index%d/number_of_sets", cpu, i);
+        t->llc_sets = topo_read_first(path, 0);
+    }
+}
+
+static inline enum topo_rel topo_relation(const struct cpu_topo *a, const struct cpu_topo *b) {
+    if (a->cpu == b->cpu) return REL_SELF;
+    if (a->pkg != b->pkg) return REL_REMOTE;
+    if (a->core == b->core) return REL_SMT;
+    if (a->llc == b->llc) return REL_LLC;
+    if (a->die == b->die) return REL_DIE;
+    return REL_PKG;
+}
+
+#endif // TOPO_H
@@ -0,0 +1,78 @@
+// walk.h -- line visiting orders over a buffer, shared by patterns.c and
+// matrix.c.
+//
+// Each order covers every 64 B line of an n-line buffer exactly once and is
+// materialised as a uint32 index array (walk_fill), so the timed loop is
+// the same for all of them:
+//   seq-fwd / seq-bwd   address order, ascending / descending
+//   stride-N            every N bytes, then the next offset inside the
+//                       stride, and so on
+//   tile-WxH            TILE_W x TILE_H line tiles of a matrix with
+//                       TILE_PITCH-byte rows, tiles in row-major order
+//   rand                a random permutation
+#ifndef WALK_H
+#define WALK_H
+
+#include "bench.h"
+#include "chase.h"
+
+#define TILE_PITCH   (16 * 1024)
+#define TILE_W       8          // lines
+#define TILE_H       8          // rows
+
+enum walk { W_SEQ_FWD, W_SEQ_BWD, W_STRIDE, W_TILE, W_RAND };
+
+struct pattern {
+    char name[24];
+    enum walk walk;
+    size_t stride;              // lines, W_STRIDE only
+};
+
+// Parses a pattern name as printed above ("stride-256" etc.). 0 on success.
+static inline int walk_parse(const char *s, struct pattern *p) {
+    memset(p, 0, sizeof(*p));
+    snprintf(p->name, sizeof(p->name), "%s", s);
+    if (!strcmp(s, "seq-fwd")) p->walk = W_SEQ_FWD;
+    else if (!strcmp(s, "seq-bwd")) p->walk = W_SEQ_BWD;
+    else if (!strncmp(s, "tile", 4)) p->walk = W_TILE;
+    else if (!strcmp(s, "rand")) p->walk = W_RAND;
+    else if (!strncmp(s, "stride-", 7) && atol(s + 7) >= 2 * CACHELINE) {
+        p->walk = W_STRIDE;
+        p->stride = (size_t)atol(s + 7) / CACHELINE;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Writes the visiting order of `p` over n lines into idx. W_TILE needs n
+// to be a multiple of TILE_H rows of TILE_PITCH bytes.
+static inline void walk_fill(const struct pattern *p, uint32_t *idx, size_t n) {
+    size_t k = 0;
+    switch (p->walk) {
+    case W_SEQ_FWD: for (size_t i = 0; i < n; ++i) idx[i] = (uint32_t)i; break;
+    case W_SEQ_BWD: for (size_t i = 0; i < n; ++i) idx[i] = (uint32_t)(n - 1 - i); break;
+    case W_STRIDE:
+        for (size_t start = 0; start < p->stride; ++start)
+            for (size_t j = start; j < n; j += p->stride) idx[k++] = (uint32_t)j;
+        break;
+    case W_TILE: {
+        size_t w = TILE_PITCH / CACHELINE, rows = n / w;
+        for (size_t tr = 0; tr < rows; tr += TILE_H)
+            for (size_t tc = 0; tc < w; tc += TILE_W)
+                for (size_t r = tr; r < tr + TILE_H; ++r)
+                    for (size_t c = tc; c < tc + TILE_W; ++c) idx[k++] = (uint32_t)(r * w + c);
+        break;
+    }
+    case W_RAND: chase_cycle(idx, n); break;       // any random order will do
+    }
+}
+
+// One independent 8-byte load per line, in idx order.
+static inline uint64_t walk_load_pass(const char *base, const uint32_t *idx, size_t n) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; ++i) sum += *(const uint64_t *)(base + (size_t)idx[i] * CACHELINE);
+    return sum;
+}
+
+#endif // WALK_H